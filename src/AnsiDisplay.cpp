@@ -0,0 +1,260 @@
+#include "AnsiDisplay.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <unistd.h>
+
+constexpr int ON = 114, OFF = 232, SOUND = 204; // 256-color palette, as the ncurses front end
+constexpr int WIDTH = SCREEN_WIDTH + 2;         // Screen and its border, in columns
+
+AnsiDisplay::AnsiDisplay(Emulator& emulator): emulator(emulator) {
+    if (tcgetattr(STDIN_FILENO, &saved) != 0) throw std::runtime_error("chip8: --ansi needs a terminal");
+    termios raw = saved;
+    cfmakeraw(&raw);
+    raw.c_cc[VMIN] = 0, raw.c_cc[VTIME] = 0; // Non blocking read()
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+
+    Put("\x1b[?1049h\x1b[?25l"); // Alternate screen, invisible cursor
+    Flush();
+    second_start = Emulator::Now();
+}
+
+AnsiDisplay::~AnsiDisplay() {
+    Put("\x1b[0m\x1b[?25h\x1b[?1049l");
+    Flush();
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    if (total.frames)
+        std::fprintf(stderr, "%llu frames sent, %.0f bytes and %.1f us each on average\n",
+                     static_cast<unsigned long long>(total.frames),
+                     double(total.bytes) / total.frames, total.ns / 1e3 / total.frames);
+}
+
+void AnsiDisplay::Refresh() {
+    UserInput();
+    frame = &emulator.Latest();
+    auto start = Emulator::Now();
+
+    // Measured instructions per second and frame costs, once per second
+    if (start - second_start >= 1000000000) {
+        ips = (frame->cycles - second_cycles) * 1e9 / (start - second_start);
+        frame_bytes = second.frames ? second.bytes / second.frames : 0;
+        frame_us    = second.frames ? second.ns / 1000 / second.frames : 0;
+        second = { }, second_start = start, second_cycles = frame->cycles;
+    }
+
+    if (full_redraw) Put("\x1b[0m\x1b[2J"), fg = bg = -1, row = col = 0;
+    bool sound  = frame->ST > 0;
+    bool recolor = full_redraw || sound != drawn.sound;
+    bool redraw  = full_redraw || frame->hires != drawn.hires;
+    if (recolor) Border(sound);
+    Labels(recolor, sound);
+    drawn.sound = sound, drawn.hires = frame->hires;
+    if (frame->hires) HiresScreen(redraw);
+    else              Screen(redraw);
+
+    std::uint64_t bytes = out - buffer.data();
+    Flush();
+    if (bytes) {
+        auto ns = Emulator::Now() - start;
+        second.frames++, second.bytes += bytes, second.ns += ns;
+        total.frames++,  total.bytes  += bytes, total.ns  += ns;
+    }
+    full_redraw = false;
+
+    // On screen now: the time since the key press it answers is the latency
+    if (frame->responded != responded) {
+        responded = frame->responded;
+        latency   = (Emulator::Now() - responded) / 1000000;
+    }
+}
+
+// Raw mode hands over bytes: escape sequences are read whole, F5, F6 and
+// F9 are the only ones used, a lone escape quits
+void AnsiDisplay::UserInput() {
+    using Command = Emulator::Command;
+    auto send = [this](Command::Type type, char key = 0) { emulator.Send({type, key, Emulator::Now()}); };
+
+    char in[64];
+    for (ssize_t n; (n = read(STDIN_FILENO, in, sizeof in)) > 0; ) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (in[i] == 27 && i+1 < n && (in[i+1] == '[' || in[i+1] == 'O')) {
+                auto begin = i + 2;
+                for (i = begin; i < n && (in[i] < 0x40 || in[i] > 0x7e); i++) { } // Up to the final byte
+                std::string_view sequence(in + begin, std::min(i + 1, n) - begin);
+                if      (sequence == "15~") send(Command::SAVE);                                 // F5
+                else if (sequence == "17~") send(Command::TRACE);                                // F6
+                else if (sequence == "20~") send(Command::LOAD), full_redraw = true;             // F9
+                continue;
+            }
+            switch (in[i]) {
+                case 27: case 3:    send(Command::QUIT);                       break; // Esc, ^C
+                case ' ':           send(Command::PAUSE);                      break;
+                case '\t':          send(Command::STEP);                       break;
+                case '\r': case '\n': send(Command::RESET), full_redraw = true; break;
+                case '-':           send(Command::SLOWER);                     break;
+                case '+':           send(Command::FASTER);                     break;
+                case 'm':           send(Command::UNTHROTTLE);                 break; // Max speed
+                case 'b':           send(Command::BREAK);                      break; // At PC
+                case 'n':           send(Command::WATCH);                      break; // Writes at I
+                case 127: case 8:   send(Command::REWIND);                     break; // Backspace
+                default:            send(Command::KEY, in[i]);                 break; // Hexpad
+            }
+        }
+    }
+}
+
+// Sides of the box, red while the sound timer runs
+void AnsiDisplay::Border(bool sound) {
+    Color(sound ? SOUND : -1, -1);
+    for (int r = 2; r <= SCREEN_HEIGHT/2 + 1; r++) {
+        Move(r, 1);     Put("│"); col++;
+        Move(r, WIDTH); Put("│"); col++;
+    }
+}
+
+// Top and bottom of the box with their labels, and the frame statistics
+// under it, whenever any of their text changes
+void AnsiDisplay::Labels(bool redraw, bool sound) {
+    char top_left[TOP_LEFT], top_right[TOP_RIGHT], bottom[BOTTOM], stats[STATS], text[sizeof drawn.labels];
+    std::snprintf(top_left, sizeof top_left, "[%s]%s%s%s%s%s", emulator.Rom().Filename().c_str(),
+                  frame->quirks != Quirks::DEFAULT ? "|[" : "",
+                  frame->quirks != Quirks::DEFAULT ? Quirks::Name(frame->quirks).c_str() : "",
+                  frame->quirks != Quirks::DEFAULT ? "]" : "",
+                  frame->fault[0] ? "|[" : "", frame->fault[0] ? frame->fault.data() + 7 : ""); // Past "chip8: "
+    if (frame->fault[0]) std::strncat(top_left, "]", sizeof top_left - std::strlen(top_left) - 1);
+    std::snprintf(top_right, sizeof top_right, "[in %4ums]|[%5u ips]", std::min(latency, 9999u), ips);
+    if (frame->unthrottled) std::snprintf(bottom, sizeof bottom, "[esc->quit]|[enter->reset]|[spc->pause]|[tab->step]|[max]");
+    else std::snprintf(bottom, sizeof bottom, "[esc->quit]|[enter->reset]|[spc->pause]|[tab->step]|[-%.0fHz+]", frame->cycle_speed);
+    std::snprintf(stats, sizeof stats, "%6u bytes/frame %6u us/frame", frame_bytes, frame_us);
+
+    std::snprintf(text, sizeof text, "%s\n%s\n%s\n%s", top_left, top_right, bottom, stats);
+    if (!redraw && std::strcmp(text, drawn.labels) == 0) return;
+    std::memcpy(drawn.labels, text, sizeof text);
+
+    Color(sound ? SOUND : -1, -1);
+    Bar(1, top_left, top_right, true);
+    Bar(SCREEN_HEIGHT/2 + 2, bottom, "", false);
+    Color(-1, -1);
+    Move(SCREEN_HEIGHT/2 + 3, 3); Put(stats); Put("\x1b[K");
+    row = col = 0;
+}
+
+// halfblock char, foreground for the bottom pixel and background for the
+// top one, as the ncurses front end; runs of changed cells left to right
+void AnsiDisplay::Screen(bool redraw) {
+    for (int r = 0; r < SCREEN_HEIGHT; r += 2) {
+        auto top = frame->pixels[r], bot = frame->pixels[r+1];
+        auto changed = redraw ? ~0ull : (top ^ drawn.pixels[r]) | (bot ^ drawn.pixels[r+1]);
+        drawn.pixels[r] = top, drawn.pixels[r+1] = bot;
+        while (changed) {
+            int c = __builtin_clzll(changed); // Highest set bit is the leftmost cell
+            changed &= ~(1ull << 63 >> c);
+            Move(r/2 + 2, c + 2);
+            Color(bot << c >> 63 ? ON : OFF, top << c >> 63 ? ON : OFF);
+            Put("▄"); col++;
+        }
+    }
+}
+
+// SUPER-CHIP 128x64: one braille character per 2x4 pixels, as the ncurses
+// front end
+void AnsiDisplay::HiresScreen(bool redraw) {
+    static constexpr std::uint8_t dots[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+    auto pixel = [this](int x, int y) { return frame->hires_pixels[y][x / 64] >> (63 - x % 64) & 1; };
+
+    for (int r = 0; r < HIRES_HEIGHT; r += 4) {
+        for (int word = 0; word < 2; word++) {
+            std::uint64_t changed = redraw ? ~0ull : 0;
+            for (int y = r; y < r + 4; y++) {
+                changed |= frame->hires_pixels[y][word] ^ drawn.hires_pixels[y][word];
+                drawn.hires_pixels[y][word] = frame->hires_pixels[y][word];
+            }
+            changed = (changed | changed << 1) & 0xaaaaaaaaaaaaaaaa; // Left column of each changed cell
+            while (changed) {
+                int x = word * 64 + __builtin_clzll(changed);
+                changed &= ~(1ull << 63 >> x % 64);
+                unsigned cell = 0;
+                for (int dy = 0; dy < 4; dy++)
+                    for (int dx = 0; dx < 2; dx++)
+                        if (pixel(x + dx, r + dy)) cell |= dots[dy][dx];
+                Move(r/4 + 2, x/2 + 2);
+                Color(ON, OFF);
+                char glyph[4] = {'\xe2', static_cast<char>(0xa0 | cell >> 6), static_cast<char>(0x80 | (cell & 0x3f)), 0};
+                Put(glyph); col++;
+            }
+        }
+    }
+}
+
+void AnsiDisplay::Put(const char* text) {
+    auto length = std::strlen(text);
+    out = std::copy_n(text, length, out);
+}
+
+// A box edge with `left` after its corner and `right` before the other one,
+// '|' standing for the line between labels; `left` is cut to fit
+void AnsiDisplay::Bar(int at_row, const char* left, const char* right, bool top) {
+    auto line = [this](const char* text, std::size_t length) {
+        for (std::size_t i = 0; i < length; i++)
+            if (text[i] == '|') Put("─"); else *out++ = text[i];
+    };
+    std::size_t inside = WIDTH - 4; // Between the corners and the line next to each
+    std::size_t r = std::strlen(right), l = std::min(std::strlen(left), inside - r - (r ? 1 : 0));
+    Move(at_row, 1);
+    Put(top ? "┌─" : "└─");
+    line(left, l);
+    for (auto fill = inside - l - r; fill; fill--) Put("─");
+    line(right, r);
+    Put(top ? "─┐" : "─┘");
+    row = col = 0;
+}
+
+void AnsiDisplay::Number(unsigned value) {
+    char digits[10];
+    int n = 0;
+    do digits[n++] = '0' + value % 10; while (value /= 10);
+    while (n) *out++ = digits[--n];
+}
+
+// Shortest way there: nothing, a jump right on the same line, or an
+// absolute position
+void AnsiDisplay::Move(int to_row, int to_col) {
+    if (to_row == row && to_col == col) return;
+    if (to_row == row && col && to_col > col) {
+        Put("\x1b[");
+        if (to_col - col > 1) Number(to_col - col);
+        *out++ = 'C';
+    } else {
+        Put("\x1b["); Number(to_row); *out++ = ';'; Number(to_col); *out++ = 'H';
+    }
+    row = to_row, col = to_col;
+}
+
+void AnsiDisplay::Color(int to_fg, int to_bg) {
+    if (to_fg == fg && to_bg == bg) return;
+    Put("\x1b[");
+    if (to_fg != fg) {
+        if (to_fg < 0) Put("39"); else Put("38;5;"), Number(to_fg);
+        if (to_bg != bg) *out++ = ';';
+    }
+    if (to_bg != bg) {
+        if (to_bg < 0) Put("49"); else Put("48;5;"), Number(to_bg);
+    }
+    *out++ = 'm';
+    fg = to_fg, bg = to_bg;
+}
+
+void AnsiDisplay::Flush() {
+    std::size_t size = out - buffer.data();
+    for (std::size_t done = 0; done < size; ) {
+        auto written = write(STDOUT_FILENO, buffer.data() + done, size - done);
+        if (written > 0) { done += written; continue; }
+        if (written < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        break; // Terminal gone, nothing left to draw on
+    }
+    out = buffer.data();
+}
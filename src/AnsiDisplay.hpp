@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include "Emulator.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <termios.h>
+
+// Front end without ncurses, for remote terminals (--ansi): the emulator
+// screen and its title bar only, rendered straight into one preallocated
+// buffer of ANSI escapes and sent with a single write() per frame. Cells
+// that did not change are not sent, a cursor jump starts each changed run
+// and colors are only set where they change, so a still screen costs
+// nothing. The title bar shows the average bytes and render time of the
+// frames sent over the last second.
+class AnsiDisplay final {
+public:
+     AnsiDisplay(Emulator& emulator); // Raw mode, alternate screen
+    ~AnsiDisplay();                   // Restores the terminal, prints the totals
+
+    AnsiDisplay(const AnsiDisplay&) = delete;
+    AnsiDisplay& operator=(const AnsiDisplay&) = delete;
+
+    void Refresh(); // At most once per terminal frame
+
+private:
+    // Every cell recolored and moved to, with room for the frame around it
+    static constexpr std::size_t CAPACITY = 64 << 10;
+
+    // Labels(): both bars and the statistics line, each with its NUL, which
+    // becomes the newline between them in `Drawn::labels`
+    static constexpr std::size_t TOP_LEFT = 128, TOP_RIGHT = 48, BOTTOM = 96, STATS = 64;
+
+    Emulator&       emulator;
+    const Snapshot* frame = nullptr; // Being drawn
+    termios         saved = { };     // Terminal settings to restore
+
+    std::array<char, CAPACITY> buffer;
+    char* out = buffer.data();
+    int   row = 0, col = 0;          // Terminal cursor, 1-based, 0 when unknown
+    int   fg  = -2, bg = -2;         // Colors in effect, -1 default, -2 unknown
+
+    // What is currently on screen, only what differs from it gets sent
+    struct Drawn {
+        std::array<std::uint64_t, SCREEN_HEIGHT> pixels = { };
+        std::array<HiresRow, HIRES_HEIGHT>       hires_pixels = { };
+        bool hires = false;
+        bool sound = false;
+        char labels[TOP_LEFT + TOP_RIGHT + BOTTOM + STATS] = { }; // Text of both bars and the statistics line
+    } drawn;
+    bool full_redraw = true;
+
+    std::uint64_t responded = 0; // Last Snapshot::responded seen
+    unsigned      latency   = 0; // Key press to the frame showing its effect, ms
+
+    // Frames sent: this second so far, the last second's averages, and totals
+    struct Stats { std::uint64_t frames = 0, bytes = 0, ns = 0; } second, total;
+    std::uint64_t second_start = 0, second_cycles = 0;
+    unsigned      ips = 0, frame_bytes = 0, frame_us = 0;
+
+    void UserInput(); // Every key waiting in the terminal
+
+    void Border(bool sound);
+    void Labels(bool redraw, bool sound);
+    void Screen(bool redraw);
+    void HiresScreen(bool redraw);
+
+    // Emitters, into `out`
+    void Put(const char* text);
+    void Bar(int at_row, const char* left, const char* right, bool top);
+    void Number(unsigned value);
+    void Move(int to_row, int to_col);
+    void Color(int to_fg, int to_bg);
+    void Flush(); // The whole buffer, one write()
+};
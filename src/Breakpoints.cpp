@@ -0,0 +1,181 @@
+#include "Breakpoints.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+static const char* const Compares[] = {"==", "!=", "<", ">", "<=", ">="};
+
+void Breakpoints::Break(int address, const Condition* condition) {
+    Breakpoint point;
+    point.address = address < 0 ? ANYWHERE : address & 0xfff;
+    if (condition) point.conditional = true, point.condition = *condition;
+    breaks.push_back(point);
+    Update();
+}
+
+void Breakpoints::Watch(std::uint16_t first, std::size_t length, std::uint8_t access) {
+    for (std::size_t i = 0; i < length; i++) {
+        if (access & READ)  reads.set((first + i) & 0xfff);
+        if (access & WRITE) writes.set((first + i) & 0xfff);
+    }
+    Update();
+}
+
+void Breakpoints::Clear() {
+    breaks.clear();
+    reads.reset(), writes.reset();
+    Update();
+}
+
+bool Breakpoints::Toggle(std::uint16_t address) {
+    address &= 0xfff;
+    auto set = code[address];
+    breaks.erase(std::remove_if(breaks.begin(), breaks.end(),
+                                [address](auto& point) { return point.address == address; }), breaks.end());
+    if (!set) breaks.push_back({address, false, { }});
+    Update();
+    return !set;
+}
+
+bool Breakpoints::ToggleWatch(const Machine& m, std::uint8_t quirks) {
+    std::uint16_t OP = m.memory[m.PC & 0xfff] << 8 | m.memory[(m.PC+1) & 0xfff];
+    std::size_t length;
+    if (Accesses(Decode(OP), X(OP), N(OP), quirks, length) == NONE) length = 1;
+    bool all = true;
+    for (std::size_t i = 0; i < length; i++) all &= writes[(m.I + i) & 0xfff];
+    for (std::size_t i = 0; i < length; i++) writes.set((m.I + i) & 0xfff, !all);
+    Update();
+    return !all;
+}
+
+Breakpoints::Access Breakpoints::Accesses(Opcode op, std::uint8_t X, std::uint8_t N, std::uint8_t quirks,
+                                          std::size_t& length) {
+    switch (op) {
+        case Opcode::DRW:       length = (quirks & Quirks::SCHIP) && N == 0 ? 32 : N; return READ;
+        case Opcode::LD_B_VX:   length = 3;     return WRITE;
+        case Opcode::LD_MEM_VX: length = X + 1; return WRITE;
+        case Opcode::LD_VX_MEM: length = X + 1; return READ;
+        default:                length = 0;     return NONE;
+    }
+}
+
+void Breakpoints::Update() {
+    code.reset();
+    anywhere = 0;
+    for (auto& point: breaks)
+        if (point.address == ANYWHERE) anywhere++;
+        else code.set(point.address);
+    watching = reads.any() || writes.any();
+    armed    = !breaks.empty() || watching;
+}
+
+// "chip8: Break at 0234", then the condition that held if any
+bool Breakpoints::Stops(const Machine& m) {
+    for (auto& point: breaks) {
+        if (point.address != ANYWHERE && point.address != (m.PC & 0xfff)) continue;
+        char text[32];
+        if (point.conditional) {
+            auto& c = point.condition;
+            int value = c.reg < 16 ? m.V[c.reg] : m.I;
+            bool holds = false;
+            switch (c.compare) {
+                case Condition::EQ: holds = value == c.value; break;
+                case Condition::NE: holds = value != c.value; break;
+                case Condition::LT: holds = value <  c.value; break;
+                case Condition::GT: holds = value >  c.value; break;
+                case Condition::LE: holds = value <= c.value; break;
+                case Condition::GE: holds = value >= c.value; break;
+            }
+            if (!holds) continue;
+            if (c.reg < 16) std::snprintf(text, sizeof text, "chip8: Break at %04x, v%x %s %02x",
+                                          m.PC, c.reg, Compares[c.compare], c.value);
+            else            std::snprintf(text, sizeof text, "chip8: Break at %04x, i %s %04x",
+                                          m.PC, Compares[c.compare], c.value);
+        } else {
+            std::snprintf(text, sizeof text, "chip8: Break at %04x", m.PC);
+        }
+        reason = text, resume = m.PC;
+        return true;
+    }
+    return false;
+}
+
+// "chip8: Write to 0300 at 0234", the first watched byte
+bool Breakpoints::Touches(const Machine& m, const Instruction& in, std::uint8_t quirks) {
+    std::size_t length;
+    auto access = Accesses(in.op, in.X, in.N, quirks, length);
+    auto& watched = access == READ ? reads : writes;
+    for (std::size_t i = 0; i < length; i++) {
+        auto address = (m.I + i) & 0xfff;
+        if (!watched[address]) continue;
+        char text[32];
+        std::snprintf(text, sizeof text, "chip8: %s %04zx at %04x",
+                      access == READ ? "Read of" : "Write to", address, m.PC);
+        reason = text, resume = m.PC;
+        return true;
+    }
+    return false;
+}
+
+void Breakpoints::Load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) throw std::runtime_error("chip8: Cannot open script " + filename);
+    for (std::string line; std::getline(file, line); ) Parse(line);
+}
+
+void Breakpoints::Parse(const std::string& line) {
+    auto bad = [&line]() { return std::runtime_error("chip8: Bad breakpoint \"" + line + "\""); };
+    auto hex = [&bad](const std::string& text, unsigned limit) {
+        std::size_t used = 0;
+        unsigned long value = 0;
+        try { value = std::stoul(text, &used, 16); } catch (const std::exception&) { throw bad(); }
+        if (used != text.size() || value > limit) throw bad();
+        return static_cast<std::uint16_t>(value);
+    };
+
+    std::istringstream in(line.substr(0, line.find('#')));
+    std::vector<std::string> words;
+    for (std::string word; in >> word; ) words.push_back(word);
+    if (words.empty()) return;
+
+    if (words[0] == "break") {
+        std::size_t at = 1;
+        int address = ANYWHERE;
+        if (at < words.size() && words[at] != "if") address = hex(words[at++], 0xfff);
+        if (at == words.size()) return Break(address);
+        if (words.size() != at + 4 || words[at] != "if") throw bad();
+
+        Condition condition;
+        auto& reg = words[at+1];
+        if (reg == "i" || reg == "I") condition.reg = 16;
+        else if (reg.size() == 2 && (reg[0] == 'v' || reg[0] == 'V')) condition.reg = hex(reg.substr(1), 0xf);
+        else throw bad();
+        auto compare = std::find(std::begin(Compares), std::end(Compares), words[at+2]);
+        if (compare == std::end(Compares)) throw bad();
+        condition.compare = static_cast<Condition::Compare>(compare - std::begin(Compares));
+        condition.value   = hex(words[at+3], condition.reg < 16 ? 0xff : 0xffff);
+        return Break(address, &condition);
+    }
+
+    if (words[0] == "watch") {
+        std::size_t at = 1;
+        if (at == words.size()) throw bad();
+        auto first = hex(words[at++], 0xfff), last = first;
+        if (at < words.size() && words[at].find_first_not_of("rw") != std::string::npos)
+            last = hex(words[at++], 0xfff);
+        std::uint8_t access = WRITE;
+        if (at < words.size()) {
+            auto& mode = words[at++];
+            if      (mode == "r")  access = READ;
+            else if (mode == "w")  access = WRITE;
+            else if (mode == "rw") access = READ | WRITE;
+            else throw bad();
+        }
+        if (at != words.size() || last < first) throw bad();
+        return Watch(first, last - first + 1, access);
+    }
+    throw bad();
+}
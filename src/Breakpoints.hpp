@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Chip8.hpp"
+
+#include <bitset>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+// Breakpoints on addresses, optionally only while a register compares to a
+// value, and watchpoints on memory bytes read or written through I. Each
+// address with a breakpoint is a bit of a 4096-bit map tested before every
+// instruction; the watched bytes are two more maps, for reads and writes,
+// that only DXYN, FX33, FX55 and FX65 look up. Chip8 only checks them in the
+// interpreters it switches to while any is set, the plain interpreters and
+// the JIT never do. A hit stops the machine before the instruction, as a
+// trap does, with Reason() as the fault; the next check lets the same
+// address through, so that resuming moves on.
+//
+// Scripts (Load()) set them one per line, addresses and values in hex,
+// '#' starts a comment:
+//
+//     break 2a0               # Stop at 0x2a0
+//     break 2a0 if v3 == 5    # ... when V3 is 5 there (==, !=, <, >, <=, >=)
+//     break if i > e00        # Before any instruction, while I is past 0xe00
+//     watch 300 30f           # Writes to 0x300-0x30f (w, r, rw)
+class Breakpoints final {
+public:
+    // `reg compare value`, reg 0-15 for V0-VF, 16 for I
+    struct Condition {
+        enum Compare : std::uint8_t { EQ, NE, LT, GT, LE, GE };
+        std::uint8_t  reg     = 0;
+        Compare       compare = EQ;
+        std::uint16_t value   = 0;
+    };
+
+    enum Access : std::uint8_t { NONE = 0, READ = 1, WRITE = 2 };
+
+    static constexpr int ANYWHERE = -1;
+
+    // At `address` (ANYWHERE: before every instruction), on `condition` if set
+    void Break(int address, const Condition* condition = nullptr);
+    void Watch(std::uint16_t first, std::size_t length, std::uint8_t access);
+    void Clear();
+
+    // Front end keys: an unconditional breakpoint at `address` or none at
+    // all there, and write watches on the bytes the instruction at PC
+    // accesses (the sprite of a DXYN...), or the one at I for the others.
+    // True when set.
+    bool Toggle(std::uint16_t address);
+    bool ToggleWatch(const Machine& m, std::uint8_t quirks);
+
+    void Load(const std::string& filename); // Script, throws on any bad line
+    void Parse(const std::string& line);
+
+    bool Armed() const { return armed; }
+    const std::bitset<4096>& Addresses() const { return code; }
+    const std::string& Reason() const { return reason; } // Of the last hit
+
+    // Before each instruction, from the checking interpreters: true to stop
+    // before it
+    inline bool Hit(const Machine& m, const Instruction& in, std::uint8_t quirks) {
+        if (std::exchange(resume, NOWHERE) == m.PC) return false;
+        if ((code[m.PC & 0xfff] || anywhere) && Stops(m)) return true;
+        return watching && (in.op == Opcode::DRW || (in.op >= Opcode::LD_B_VX && in.op <= Opcode::LD_VX_MEM))
+            && Touches(m, in, quirks);
+    }
+
+    // The bytes from I an instruction reads or writes, `length` of them
+    static Access Accesses(Opcode op, std::uint8_t X, std::uint8_t N, std::uint8_t quirks, std::size_t& length);
+
+private:
+    struct Breakpoint {
+        int       address = ANYWHERE;
+        bool      conditional = false;
+        Condition condition;
+    };
+
+    static constexpr int NOWHERE = -1;
+
+    std::vector<Breakpoint> breaks;
+    std::bitset<4096>       code;          // Addresses of `breaks`
+    std::bitset<4096>       reads, writes; // Watched bytes
+    std::size_t             anywhere = 0;  // ANYWHERE breakpoints
+    bool                    watching = false;
+    bool                    armed    = false;
+    int                     resume   = NOWHERE; // Address of the last hit, let through once
+    std::string             reason;
+
+    void Update();
+    bool Stops(const Machine& m);
+    bool Touches(const Machine& m, const Instruction& in, std::uint8_t quirks);
+};
@@ -1,39 +1,349 @@
 #include "Chip8.hpp"
+#include "Breakpoints.hpp"
+#include "Trace.hpp"
 
-// The Dispatch hashtable, is in the header file.
+// The handlers are in the header file.
 
-Chip8::Chip8(const std::string& filename): filename(filename) {
-    LoadROM(filename);
+const std::array<Chip8::Interpreter, Quirks::COUNT> Chip8::interpreters =
+    Chip8::Instantiate<false>(std::make_index_sequence<Quirks::COUNT>());
+const std::array<Chip8::Interpreter, Quirks::COUNT> Chip8::hooked_interpreters =
+    Chip8::Instantiate<true>(std::make_index_sequence<Quirks::COUNT>());
+
+Chip8::Chip8(const std::string& filename): Chip8(RomImage::Load(filename)) { }
+
+Chip8::Chip8(std::shared_ptr<const RomImage> rom): rom(std::move(rom)) {
+    LoadROM();
     LoadFont();
+    Seed(0);
+}
+
+Chip8::~Chip8() = default;
+
+Chip8::Chip8(const Chip8& other): Machine(other) { *this = other; }
+
+Chip8& Chip8::operator=(const Chip8& other) {
+    if (this == &other) return *this;
+    static_cast<Machine&>(*this) = other;
+    rom         = other.rom;
+    cycle_speed = other.cycle_speed;
+    quirks = other.quirks, interpreter = other.interpreter, hooked = other.hooked;
+    unthrottled = other.unthrottled;
+    quit = other.quit, paused = other.paused, step = other.step, rewind = other.rewind;
+    input_log = nullptr, trace = nullptr, breakpoints = nullptr;
+    idle_skip = other.idle_skip;
+    cache.reset(), jit.reset();
+    EnableCache(other.cache != nullptr);
+    EnableJit(other.jit != nullptr);
+    return *this;
+}
+
+// splitmix64 spreads small seeds over the whole state, which must not be 0
+void Chip8::Seed(std::uint64_t seed) {
+    auto z = seed + 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    rng = (z ^ (z >> 31)) | (z == 0);
+}
+
+bool Chip8::PressKey(char key) {
+    if (!hexpad.Press(key)) return false;
+    if (input_log) input_log->Record(cycles, InputLog::Type::KEY, static_cast<std::uint8_t>(key));
+    return true;
+}
+
+bool Chip8::ReleaseKey(char key) {
+    if (!hexpad.Release(key)) return false;
+    if (input_log) input_log->Record(cycles, InputLog::Type::RELEASE, static_cast<std::uint8_t>(key));
+    return true;
+}
+
+void Chip8::SetKeyHold(int ticks) {
+    if (ticks < 1 || ticks > Keyboard::HELD) throw std::runtime_error("chip8: Key hold must be 1 to 127 ticks");
+    hexpad.hold = ticks;
+}
+
+void Chip8::LogTimers() {
+    input_log->Record(cycles, InputLog::Type::TIMER);
+    if (input_log->ticks % InputLog::HASH_INTERVAL == 0)
+        input_log->Record(cycles, InputLog::Type::HASH, FrameHash());
 }
 
+void Chip8::TraceTick() { trace->Tick(*this); }
+
+bool Chip8::Hooked() const { return trace || (breakpoints && breakpoints->Armed()); }
+
 void Chip8::Cycle() {
     if (!paused || step) {
-        OP = memory[PC] << 8 | memory[PC+1]; // Next two bytes
-        PC += 2; step = false; // Increment PC for next cycle
-
-        auto op_ptr = std::function<void()>();
-        // Masks ordered that way to avoid collision
-        for (auto mask: {0xf0ff, 0xf00f, 0xf000})
-            if ((op_ptr = Dispatch[(OP & mask)]) != nullptr)
-                return std::invoke(op_ptr);
+        step = false;
+        Run(1);
     }
 }
 
-void Chip8::LoadROM(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (file.is_open()) {
-        auto bytes_size = static_cast<std::size_t>(file.read(
-            reinterpret_cast<char*>(memory.data()) + ENTRY_POINT,
-            memory.size() - ENTRY_POINT).gcount());
-        if (bytes_size > 4096 - ENTRY_POINT)
-            throw std::runtime_error("chip8: Failed to fit ROM in memory");
-    } else throw std::runtime_error("chip8: Failed to open file");
+void Chip8::Run(std::uint64_t count) {
+    if (idle_skip) count = SkipIdle(count);
+    if (jit && !Hooked()) jit->Run(count);
+    else               Interpret(count);
+}
+
+namespace {
+    constexpr std::uint64_t IDLE_LOOP = 8; // Longest loop looked for, instructions
+
+    // Reads anything, writes V, I, PC or a key latch (FX0A) only
+    constexpr bool Pure(Opcode op) {
+        switch (op) {
+            case Opcode::CLS:      case Opcode::RET:       case Opcode::CALL:
+            case Opcode::RND:      case Opcode::DRW:       case Opcode::LD_DT_VX:
+            case Opcode::LD_ST_VX: case Opcode::LD_B_VX:   case Opcode::LD_MEM_VX:
+            case Opcode::SCD:      case Opcode::SCR:       case Opcode::SCL:
+            case Opcode::LOW:      case Opcode::HIGH:      case Opcode::LD_R_VX:
+            case Opcode::COUNT:
+                return false;
+            default:
+                return true;
+        }
+    }
+}
+
+// Wait loops (FX07 until DT is 0, FX0A until a key, SKP/SKNP on a key, a
+// jump to itself, SUPER-CHIP's exit) only read the machine, and come back
+// to their first instruction with it unchanged: every turn does exactly
+// what the last one did until a timer tick or a key changes their inputs,
+// which only happens between Run()s. One turn is run one instruction at a
+// time; when it is such a loop the turns that fit in `count` are added to
+// the instruction count without running them.
+std::uint64_t Chip8::SkipIdle(std::uint64_t count) {
+    auto start = PC;
+    auto v = V; auto index = I; auto keys = hexpad.keys;
+    for (std::uint64_t step = 1; step <= std::min(count, IDLE_LOOP); step++) {
+        if (!Pure(Decode(Fetch()))) return count - step + 1;
+        Interpret(1);
+        if (PC != start) continue;
+        if (V != v || I != index || hexpad.keys != keys) return count - step;
+        auto skipped = (count - step) / step * step;
+        cycles += skipped, idle_cycles += skipped;
+        if (trace) trace->Idle(skipped);
+        return count - step - skipped;
+    }
+    return count - std::min(count, IDLE_LOOP);
+}
+
+void Chip8::SetQuirks(std::uint8_t set) {
+    if (set >= Quirks::COUNT) throw std::runtime_error("chip8: Unknown quirks");
+    quirks      = set;
+    interpreter = interpreters[set];
+    hooked      = hooked_interpreters[set];
+    if (!(quirks & Quirks::SCHIP) && hires) Resolution(false);
+    if (cache) cache->fill({ }); // Labels of the previous interpreter
+    if (jit) jit->Flush();
+}
+
+// Direct-threaded interpreter: each handler ends by fetching the next
+// Instruction and jumping straight to its label. With the cache enabled the
+// fetch is a single lookup, otherwise the two bytes at PC are decoded again,
+// as they are past 0xfff, where the same bytes have another next PC.
+// Instantiated once per quirk combination, the handlers that differ check
+// them at compile time, and once more with `Hooks` to record each
+// instruction before it runs and stop before the ones a breakpoint matches.
+template <std::uint8_t Q, bool Hooks>
+void Chip8::InterpretAs(std::uint64_t count) {
+    static const void* const labels[OPCODE_COUNT] = {
+        &&op_0nnn, &&op_00e0, &&op_00ee, &&op_1nnn, &&op_2nnn, &&op_3xnn,
+        &&op_4xnn, &&op_5xy0, &&op_6xnn, &&op_7xnn, &&op_8xy0, &&op_8xy1,
+        &&op_8xy2, &&op_8xy3, &&op_8xy4, &&op_8xy5, &&op_8xy6, &&op_8xy7,
+        &&op_8xye, &&op_9xy0, &&op_annn, &&op_bnnn, &&op_cxnn, &&op_dxyn,
+        &&op_ex9e, &&op_exa1, &&op_fx07, &&op_fx0a, &&op_fx15, &&op_fx18,
+        &&op_fx1e, &&op_fx29, &&op_fx33, &&op_fx55, &&op_fx65,
+        &&op_00cn, &&op_00fb, &&op_00fc, &&op_00fd, &&op_00fe, &&op_00ff,
+        &&op_fx30, &&op_fx75, &&op_fx85,
+        &&op_unknown
+    };
+
+    auto* const table = cache ? cache->data() : nullptr;
+    Instruction  scratch;
+    Instruction* in = &scratch;
+    auto remaining = count;
+
+    #define DISPATCH()                                                     \
+        if (remaining-- == 0) goto done;                                   \
+        in = table && PC <= 0xfff ? &table[PC] : &scratch; /* Past 0xfff */ \
+        if (in == &scratch || !in->handler) Predecode(PC, *in),            \
+            in->handler = labels[static_cast<std::size_t>(in->op)];        \
+        PROFILE(profile.Count(in->op, PC);)                                \
+        if constexpr (Hooks) {                                             \
+            if (trace) trace->Step(*this, *in);                            \
+            if (breakpoints && breakpoints->Hit(*this, *in, Q))            \
+                throw std::runtime_error(breakpoints->Reason());           \
+        }                                                                  \
+        OP = in->OP; PC = in->next;                                        \
+        goto *in->handler;
+
+    #define HANDLER(name)  name: name(*in); DISPATCH();
+    #define QUIRKED(name)  name: name<Q>(*in); DISPATCH();
+
+    // A trap or a breakpoint leaves the machine before the instruction, which
+    // does not count; jumping out of the try block is fine, only into it is not
+    try {
+    DISPATCH();
+    HANDLER(op_0nnn) QUIRKED(op_00e0) HANDLER(op_00ee) HANDLER(op_1nnn)
+    HANDLER(op_2nnn) HANDLER(op_3xnn) HANDLER(op_4xnn) HANDLER(op_5xy0)
+    HANDLER(op_6xnn) HANDLER(op_7xnn) HANDLER(op_8xy0) HANDLER(op_8xy1)
+    HANDLER(op_8xy2) HANDLER(op_8xy3) HANDLER(op_8xy4) HANDLER(op_8xy5)
+    QUIRKED(op_8xy6) HANDLER(op_8xy7) QUIRKED(op_8xye) HANDLER(op_9xy0)
+    HANDLER(op_annn) QUIRKED(op_bnnn) HANDLER(op_cxnn) QUIRKED(op_dxyn)
+    HANDLER(op_ex9e) HANDLER(op_exa1) HANDLER(op_fx07) HANDLER(op_fx0a)
+    HANDLER(op_fx15) HANDLER(op_fx18) HANDLER(op_fx1e) HANDLER(op_fx29)
+    HANDLER(op_fx33) QUIRKED(op_fx55) QUIRKED(op_fx65)
+    QUIRKED(op_00cn) QUIRKED(op_00fb) QUIRKED(op_00fc) QUIRKED(op_00fd)
+    QUIRKED(op_00fe) QUIRKED(op_00ff) QUIRKED(op_fx30) QUIRKED(op_fx75)
+    QUIRKED(op_fx85) HANDLER(op_unknown)
+    } catch (...) {
+        cycles += count - remaining - 1;
+        if constexpr (Hooks) if (trace) trace->Drop();
+        throw;
+    }
+
+    #undef QUIRKED
+    #undef HANDLER
+    #undef DISPATCH
+
+done:
+    cycles += count;
+}
+
+void Chip8::Predecode(std::uint16_t address, Instruction& in) const {
+    in.OP   = memory[address & 0xfff] << 8 | memory[(address+1) & 0xfff];
+    in.op   = Decode(in.OP);
+    in.NNN  = NNN(in.OP);
+    in.NN   = NN(in.OP);
+    in.N    = N(in.OP);
+    in.X    = X(in.OP);
+    in.Y    = Y(in.OP);
+    in.next = address + 2;
+}
+
+void Chip8::EnableCache(bool enable) {
+    if (!enable) cache.reset();
+    else if (!cache) cache = std::make_unique<InstructionCache>();
+}
+
+void Chip8::EnableJit(bool enable) {
+    PROFILE(if (enable) throw std::runtime_error("chip8: Profile builds count in the interpreter, no JIT");)
+    if (!Jit::SUPPORTED && enable) throw std::runtime_error("chip8: The JIT needs an x86-64 host");
+    if (!enable) jit.reset();
+    else if (!jit) jit = std::make_unique<Jit>(*this);
+}
+
+std::uint64_t Chip8::FrameHash() const {
+    std::uint64_t hash = 0xcbf29ce484222325;
+    if (hires) for (auto& row: hires_pixels) for (auto word: row) hash = (hash ^ word) * 0x100000001b3;
+    else       for (auto pixel: pixels) hash = (hash ^ pixel) * 0x100000001b3;
+    return hash;
+}
+
+void Chip8::Capture(Snapshot& snapshot) const {
+    snapshot.pixels = pixels;
+    snapshot.V      = V;
+    snapshot.keys   = hexpad.keys;
+    snapshot.stack  = stack;
+    snapshot.depth  = SP;
+    snapshot.PC = PC, snapshot.I  = I, snapshot.OP = OP;
+    snapshot.DT = DT, snapshot.ST = ST;
+    snapshot.cycles      = cycles;
+    snapshot.cycle_speed = cycle_speed;
+    snapshot.unthrottled = unthrottled;
+    snapshot.paused      = paused;
+    snapshot.hires       = hires;
+    snapshot.quirks      = quirks;
+    if (hires) snapshot.hires_pixels = hires_pixels;
+    PROFILE(snapshot.addresses = profile.addresses;)
+}
+
+// Layout: "C8ST", version, then every field at a fixed offset (multi-byte
+// values little endian), so two snapshots can be diffed byte for byte.
+// Version 2 appended the random state and the input log length, version 3
+// the quirks and the SUPER-CHIP state; older ones load with default quirks.
+constexpr std::uint8_t STATE_VERSION = 3;
+constexpr std::size_t  STATE_V2_SIZE = Chip8::STATE_SIZE - 2 - 16 - HIRES_HEIGHT*16;
+constexpr std::size_t  STATE_V1_SIZE = STATE_V2_SIZE - 16;
+
+void Chip8::SaveState(std::vector<std::uint8_t>& state) const {
+    state.clear(); state.reserve(STATE_SIZE);
+    auto put = [&state](std::uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) state.push_back(value >> (8*i) & 0xff);
+    };
+
+    state.insert(state.end(), {'C', '8', 'S', 'T', STATE_VERSION});
+    state.insert(state.end(), memory.begin(), memory.end());
+    state.insert(state.end(), V.begin(), V.end());
+    put(PC, 2); put(I, 2); put(OP, 2); put(DT, 1); put(ST, 1);
+    put(SP, 1);
+    for (std::size_t i = 0; i < 16; i++) put(i < SP ? stack[i] : 0, 2);
+    for (auto row: pixels) put(row, 8);
+    for (auto key: hexpad.keys) put(key, 1);
+    put(cycles, 8);
+    put(rng, 8);
+    put(input_log ? input_log->events.size() : 0, 8);
+    put(quirks, 1); put(hires, 1);
+    state.insert(state.end(), flags.begin(), flags.end());
+    for (auto& row: hires_pixels) put(row[0], 8), put(row[1], 8);
+}
+
+void Chip8::LoadState(const std::vector<std::uint8_t>& state) {
+    if (state.size() < 5 || std::string(state.begin(), state.begin()+4) != "C8ST")
+        throw std::runtime_error("chip8: Not a save state");
+    if (state[4] == 0 || state[4] > STATE_VERSION)
+        throw std::runtime_error("chip8: Unsupported save state version");
+    if (state.size() != (state[4] == 1 ? STATE_V1_SIZE : state[4] == 2 ? STATE_V2_SIZE : STATE_SIZE))
+        throw std::runtime_error("chip8: Corrupted save state");
+    if (state[4] >= 3 && state[STATE_V2_SIZE] >= Quirks::COUNT)
+        throw std::runtime_error("chip8: Corrupted save state");
+    if (state[5 + memory.size() + V.size() + 8] > 16) // Stack depth
+        throw std::runtime_error("chip8: Corrupted save state");
+
+    auto it = state.begin() + 5;
+    auto get = [&it](int bytes) {
+        std::uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) value |= std::uint64_t(*it++) << (8*i);
+        return value;
+    };
+
+    std::copy_n(it, memory.size(), memory.begin()); it += memory.size();
+    std::copy_n(it, V.size(), V.begin());           it += V.size();
+    PC = get(2); I = get(2); OP = get(2); DT = get(1); ST = get(1);
+    SP = get(1);
+    for (auto& entry: stack) entry = get(2);
+    for (auto& row: pixels) row = get(8);
+    for (auto& key: hexpad.keys) key = get(1);
+    cycles = get(8);
+    if (state[4] >= 2) {
+        rng = get(8);
+        auto events = get(8); // A recording follows the machine back in time
+        if (input_log) input_log->Truncate(events);
+    }
+    hires = false; // The current mode must not make SetQuirks() blank the pixels just loaded
+    SetQuirks(state[4] >= 3 ? get(1) : Quirks::DEFAULT);
+    hires = state[4] >= 3 && get(1);
+    flags.fill(0), hires_pixels.fill({ });
+    if (state[4] >= 3) {
+        std::copy_n(it, flags.size(), flags.begin()); it += flags.size();
+        for (auto& row: hires_pixels) row[0] = get(8), row[1] = get(8);
+    }
+
+    dirty_rows = ~0u;
+    if (cache) cache->fill({ });
+    if (jit) jit->Flush();
+    if (trace) trace->Clear();
+}
+
+void Chip8::LoadROM() {
+    std::copy_n(rom->Data(), rom->Size(), memory.begin() + ENTRY_POINT);
 }
 
 void Chip8::LoadFont() {
     std::copy(std::begin(fontset), std::end(fontset),
               std::begin(memory) + FONT_ADDRESS);
+    std::copy(std::begin(bigfontset), std::end(bigfontset),
+              std::begin(memory) + BIG_FONT_ADDRESS);
 }
 
 void Chip8::Reset() {
@@ -41,9 +351,15 @@ void Chip8::Reset() {
     I = OP = DT = ST = 0x0000;
     memory.fill(0x00);
     pixels.fill(0x00);
+    hires = false, hires_pixels.fill({ }); // The FX75 flags outlive resets, as on the HP-48
+    dirty_rows = ~0u;
     V.fill(0x0000);
-    stack.clear();
+    SP = 0;
+    if (cache) cache->fill({ });
+    if (jit) jit->Flush();
+    if (input_log) input_log->Record(cycles, InputLog::Type::RESET);
+    if (trace) trace->Clear();
 
-    LoadROM(filename);
+    LoadROM();
     LoadFont();
 }
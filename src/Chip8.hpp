@@ -1,25 +1,37 @@
 #pragma once
 
+#include "InputLog.hpp"
+#include "Jit.hpp"
 #include "Keyboard.hpp"
+#include "Opcode.hpp"
+#include "Profiler.hpp"
+#include "Quirks.hpp"
+#include "RomImage.hpp"
 
 #include <vector>
 #include <array>
+#include <bitset>
 #include <string>
 #include <cstdint>
-#include <functional>
 #include <fstream>
 #include <exception>
 #include <iostream>
 #include <unistd.h>
 #include <algorithm>
 #include <chrono>
-#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 #define SCREEN_WIDTH  64
 #define SCREEN_HEIGHT 32
+#define HIRES_WIDTH   128 // SUPER-CHIP
+#define HIRES_HEIGHT  64
 
 #define ENTRY_POINT   0x200 // Default PC
 #define FONT_ADDRESS  0x50
+#define BIG_FONT_ADDRESS 0xa0 // Right after the small one
 
 #define N(bytes)    ( bytes & 0x000f)        // ...N
 #define NN(bytes)   ( bytes & 0x00ff)        // ..NN
@@ -27,8 +39,8 @@
 #define X(bytes)    ((bytes & 0x0f00) >> 8)  // .X..
 #define Y(bytes)    ((bytes & 0x00f0) >> 4)  // ..Y.
 
-#define VX V[X(OP)]
-#define VY V[Y(OP)]
+#define VX V[in.X] // Handlers operate on a decoded Instruction `in`
+#define VY V[in.Y]
 #define VF V[0xf]
 
 
@@ -51,97 +63,375 @@ const std::array<std::uint8_t, 80> fontset {
     0xf0, 0x80, 0xf0, 0x80, 0x80  // f
 };
 
-class Display;
+// SUPER-CHIP 8x10 digits for FX30, a to f as most interpreters extend it
+const std::array<std::uint8_t, 160> bigfontset {
+    0x3c, 0x7e, 0xe7, 0xc3, 0xc3, 0xc3, 0xc3, 0xe7, 0x7e, 0x3c, // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3c, // 1
+    0x3e, 0x7f, 0xc3, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xff, 0xff, // 2
+    0x3c, 0x7e, 0xc3, 0x03, 0x0e, 0x0e, 0x03, 0xc3, 0x7e, 0x3c, // 3
+    0x06, 0x0e, 0x1e, 0x36, 0x66, 0xc6, 0xff, 0xff, 0x06, 0x06, // 4
+    0xff, 0xff, 0xc0, 0xc0, 0xfc, 0xfe, 0x03, 0xc3, 0x7e, 0x3c, // 5
+    0x3e, 0x7c, 0xe0, 0xc0, 0xfc, 0xfe, 0xc3, 0xc3, 0x7e, 0x3c, // 6
+    0xff, 0xff, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+    0x3c, 0x7e, 0xc3, 0xc3, 0x7e, 0x7e, 0xc3, 0xc3, 0x7e, 0x3c, // 8
+    0x3c, 0x7e, 0xc3, 0xc3, 0x7f, 0x3f, 0x03, 0x03, 0x3e, 0x7c, // 9
+    0x7e, 0xff, 0xc3, 0xc3, 0xc3, 0xff, 0xff, 0xc3, 0xc3, 0xc3, // a
+    0xfc, 0xfc, 0xc3, 0xc3, 0xfc, 0xfc, 0xc3, 0xc3, 0xfc, 0xfc, // b
+    0x3c, 0xff, 0xc3, 0xc0, 0xc0, 0xc0, 0xc0, 0xc3, 0xff, 0x3c, // c
+    0xfc, 0xfe, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xfe, 0xfc, // d
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, // e
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc0, 0xc0, 0xc0, 0xc0  // f
+};
+
+class Trace;
+class Breakpoints;
+
+// A SUPER-CHIP framebuffer row, the leftmost pixel is the most significant
+// bit of the first word
+using HiresRow = std::array<std::uint64_t, 2>;
+
+// One decoded instruction: the threaded-code target of its handler, the
+// pre-extracted operands, and the address of the instruction that follows.
+struct Instruction {
+    const void*   handler = nullptr; // nullptr -> not decoded yet
+    std::uint16_t OP      = 0x0000;
+    std::uint16_t NNN     = 0x0000;
+    std::uint16_t next    = 0x0000;
+    std::uint8_t  X = 0, Y = 0, N = 0, NN = 0;
+    Opcode        op      = Opcode::UNKNOWN;
+};
+
+// What a front end shows of the machine, copied out once per frame so that
+// it can be drawn from another thread than the one running the core.
+struct Snapshot {
+    std::array<std::uint64_t, SCREEN_HEIGHT> pixels = { };
+    std::array<std::uint8_t,  16>            V      = { };
+    std::array<std::uint16_t, 16>            stack  = { }; // Return addresses, `depth` of them
+    std::array<std::uint8_t,  16>            keys   = { }; // Keyboard states
+    std::uint8_t  depth = 0;
+    std::uint16_t PC = 0, I = 0, OP = 0;
+    std::uint8_t  DT = 0, ST = 0;
+    std::uint64_t cycles      = 0;
+    float         cycle_speed = 0.f;
+    bool          unthrottled = false;
+    bool          paused      = false;
+    std::array<char, 32> fault = { }; // What stopped the core, empty if nothing did
+    std::array<HiresRow, HIRES_HEIGHT> hires_pixels = { }; // Shown instead of `pixels` while `hires`
+    bool          hires  = false;
+    std::uint8_t  quirks = Quirks::DEFAULT;
+    std::uint64_t responded = 0; // Send time of the last key that changed the screen, see Emulator
+    std::bitset<4096> breakpoints; // Addresses with one, see Emulator
+    PROFILE(std::array<std::uint64_t, 4096> addresses = { };)
+};
+
+// Everything a running machine is made of, and nothing else: no pointers,
+// no heap, so copying a machine (clones, pools, snapshots) is one memcpy.
+// The fields Jit addresses and every instruction touches come first.
+struct alignas(64) Machine {
+    std::array<std::uint8_t,   16> V       = { };         // Registers
+    std::uint16_t                  PC      = ENTRY_POINT; // Program Counter
+    std::uint16_t                  I       = 0x0000;      // Index Register
+    std::uint16_t                  OP      = 0x0000;      // Current Instruction
+    std::uint8_t                   DT      = 0x00;        // Delay Timer
+    std::uint8_t                   ST      = 0x00;        // Sound Timer
+    std::uint8_t                   SP      = 0x00;        // Stack depth
+    Keyboard                       hexpad;
+    std::uint64_t                  rng     = 0x0000;      // xorshift64* state
+    std::uint64_t                  cycles     = 0;        // Instructions executed since start
+    std::uint32_t                  dirty_rows = 0;        // Framebuffer rows changed since last read
+    std::array<std::uint16_t,  16> stack   = { };
+
+    // One 64-bit word per row, the leftmost pixel is the most significant bit
+    std::array<std::uint64_t, SCREEN_HEIGHT> pixels = { };
+
+    // SUPER-CHIP: the 128x64 plane that replaces `pixels` while `hires`
+    // (dirty_rows then has a bit per two rows), and the FX75/FX85 flags
+    std::array<HiresRow, HIRES_HEIGHT> hires_pixels = { };
+    bool                               hires = false;
+    std::array<std::uint8_t, 16>       flags = { };
+
+    std::array<std::uint8_t, 4096> memory  = { };
+};
+
+static_assert(std::is_trivially_copyable_v<Machine>, "Machine must stay memcpy-able");
 
-class Chip8 final { friend Display;
+class Chip8 final : private Machine { friend Jit; friend class Lockstep;
 
 public:
     Chip8(const std::string& filename);
+    Chip8(std::shared_ptr<const RomImage> rom);
+   ~Chip8();
+
+    // Clones: the machine state, the ROM and the settings, but a fresh
+    // instruction cache and JIT, and no input log
+    Chip8(const Chip8& other);
+    Chip8& operator=(const Chip8& other);
+
+    void Cycle();                   // One instruction
+    void Run(std::uint64_t count);  // `count` instructions, ignores pause
+    void Reset();                   // Reset ROM
+    void Seed(std::uint64_t seed);  // Restart the random stream of Cxnn
+    bool PressKey(char key);        // Keyboard character, false if unmapped
+    bool ReleaseKey(char key);      // For front ends that see keys go up
+    void SetKeyHold(int ticks); // How long a press lasts, Keyboard::HELD for ever
+
+    // Decode each address once and run from the decoded records afterwards,
+    // stores to memory (Fx33, Fx55) invalidate the records they overlap.
+    void EnableCache(bool enable);
+
+    // Run() through the x86-64 recompiler instead (see Jit.hpp), same results
+    void EnableJit(bool enable);
+
+    // Count the turns of idle loops instead of running them (see SkipIdle),
+    // same results; `idle_cycles` adds up the instructions skipped
+    void EnableIdleSkip(bool enable) { idle_skip = enable; }
+    std::uint64_t idle_cycles = 0;
+
+    // Switches to the interpreter built for `quirks` (see Quirks.hpp)
+    void SetQuirks(std::uint8_t quirks);
+    std::uint8_t GetQuirks() const { return quirks; }
+
+    // Versioned binary snapshot of the whole machine, always STATE_SIZE bytes
+    static constexpr std::size_t STATE_SIZE = 5496;
+    void SaveState(std::vector<std::uint8_t>& state) const;
+    void LoadState(const std::vector<std::uint8_t>& state);
 
-    void Cycle();  // One instruction
-    void Reset();  // Reset ROM
+    inline void UpdateTimers() {
+        if (trace) TraceTick();
+        DT -= (DT>0), ST -= (ST>0);
+        hexpad.Decay();
+        if (input_log) LogTimers();
+    }
 
-    inline void UpdateTimers() { DT -= (DT>0), ST -= (ST>0); }
+    inline bool GetPixel(int x, int y) const { return pixels[y] >> (63 - x) & 0x1; }
 
-    inline bool GetPixel(int x, int y) const { return pixels[x + y*SCREEN_WIDTH]; }
+    std::uint64_t FrameHash() const; // FNV-1a of the framebuffer shown, `pixels` or `hires_pixels`
+
+    void Capture(Snapshot& snapshot) const;
+    const RomImage& Rom() const { return *rom; }
+
+    // The instruction that will execute next
+    inline std::uint16_t Fetch() const {
+        return memory[PC & 0xfff] << 8 | memory[(PC+1) & 0xfff];
+    }
+
+    using Machine::cycles;
+    using Machine::dirty_rows;
+
+    const Machine& State() const { return *this; }
+
+    PROFILE(Profiler profile;)
+
+    InputLog* input_log = nullptr; // Records keys, timer ticks and resets when set
+
+    // Records every instruction when set (see Trace.hpp): Run() goes through
+    // the interpreter, the JIT sits idle meanwhile
+    Trace* trace = nullptr;
+
+    // Checked before every instruction while any is set (see
+    // Breakpoints.hpp): Run() goes through the interpreter then too
+    Breakpoints* breakpoints = nullptr;
 
     float cycle_speed  = 150.f; // in Hertz
+    bool  unthrottled  = false; // Run as fast as possible
     bool  quit         = false;
     bool  paused       = false;
     bool  step         = false;
+    unsigned rewind    = 0;     // Frames to step back in time, one per request
 
 private:
-    std::string filename;
+    std::shared_ptr<const RomImage> rom;
 
-    std::array<std::uint8_t, 4096> memory  = { };
-    std::vector<std::uint16_t>     stack   = { };
-    std::array<std::uint8_t,   16> V       = { };         // Registers
-    std::uint16_t                  PC      = ENTRY_POINT; // Program Counter
-    std::uint16_t                  I       = 0x0000;      // Index Register
-    std::uint16_t                  OP      = 0x0000;      // Current Instruction
-    std::uint8_t                   DT      = 0x00;        // Delay Timer
-    std::uint8_t                   ST      = 0x00;        // Sound Timer
+    void LoadROM();
+    void LoadFont();
+    void LogTimers();
+    void TraceTick();
 
+    inline std::uint8_t Random() {
+        rng ^= rng >> 12, rng ^= rng << 25, rng ^= rng >> 27;
+        return (rng * 0x2545f4914f6cdd1d) >> 56;
+    }
 
-    std::array<bool, SCREEN_WIDTH*SCREEN_HEIGHT> pixels = { };
+    using InstructionCache = std::array<Instruction, 4096>;
+    std::unique_ptr<InstructionCache> cache;
 
-    Keyboard hexpad;
+    std::unique_ptr<Jit> jit;
 
-    void LoadROM(const std::string& filename);
-    void LoadFont();
+    bool idle_skip = false;
+    std::uint64_t SkipIdle(std::uint64_t count); // Instructions left to run
+
+    // One interpreter per quirk combination, and one more that records
+    // into `trace` and checks `breakpoints`; Run() calls the selected one
+    using Interpreter = void (Chip8::*)(std::uint64_t count);
+    static const std::array<Interpreter, Quirks::COUNT> interpreters, hooked_interpreters;
+
+    std::uint8_t quirks      = Quirks::DEFAULT;
+    Interpreter  interpreter = interpreters[Quirks::DEFAULT];
+    Interpreter  hooked      = hooked_interpreters[Quirks::DEFAULT];
+
+    bool Hooked() const; // Tracing, or armed breakpoints
+    void Interpret(std::uint64_t count) { (this->*(Hooked() ? hooked : interpreter))(count); }
+    template <std::uint8_t Q, bool Hooks> void InterpretAs(std::uint64_t count);
+    template <bool Hooks, std::size_t... Q>
+    static constexpr std::array<Interpreter, Quirks::COUNT> Instantiate(std::index_sequence<Q...>) {
+        return {&Chip8::InterpretAs<Q, Hooks>...};
+    }
+
+    // Faults stop the machine on the faulting instruction, uncounted
+    [[noreturn]] void Trap(const char* what) { PC -= 2; throw std::runtime_error(what); }
+    void Predecode(std::uint16_t address, Instruction& in) const;
+    inline void Invalidate(std::uint16_t address, std::size_t length) {
+        if (cache) for (auto a = address-1; a < address+(int)length; a++)
+            (*cache)[a & 0xfff].handler = nullptr;
+        if (jit) jit->Invalidate(address, length);
+    }
+
+    // Handlers, jumped to from the threaded loop in Chip8::InterpretAs().
+    // The templated ones depend on the quirks, `Q`.
+    static constexpr bool Has(std::uint8_t Q, std::uint8_t quirk) { return Q & quirk; }
+
+    void op_0nnn(const Instruction&) { void(this); }
+    template <std::uint8_t Q> void op_00e0(const Instruction&) {
+        pixels.fill(0x00); dirty_rows = ~0u;
+        if constexpr (Has(Q, Quirks::SCHIP)) hires_pixels.fill({ }); }
+    void op_00ee(const Instruction&) { if (SP == 0) Trap("chip8: Stack underflow");
+        PC = stack[--SP]; }
+    void op_1nnn(const Instruction& in) { PC = in.NNN; }
+    void op_2nnn(const Instruction& in) { if (SP == stack.size()) Trap("chip8: Stack overflow");
+        stack[SP++] = PC; PC = in.NNN;
+        PROFILE(profile.Stack(SP);) }
+    void op_3xnn(const Instruction& in) { if (VX == in.NN) PC += 0x02; }
+    void op_4xnn(const Instruction& in) { if (VX != in.NN) PC += 0x02; }
+    void op_5xy0(const Instruction& in) { if (VX == VY) PC += 0x02; }
+    void op_6xnn(const Instruction& in) { VX  = in.NN; }
+    void op_7xnn(const Instruction& in) { VX += in.NN; }
+    void op_8xy0(const Instruction& in) { VX  = VY; }
+    void op_8xy1(const Instruction& in) { VX |= VY; }
+    void op_8xy2(const Instruction& in) { VX &= VY; }
+    void op_8xy3(const Instruction& in) { VX ^= VY; }
+    void op_8xy4(const Instruction& in) { VF = (VX + VY > 0xff); VX = (VX + VY) & 0xff; }
+    void op_8xy5(const Instruction& in) { VF = (VX > VY); VX -= VY; }
+    // VF first, then VX from the registers: with VF as the source the flag is shifted
+    template <std::uint8_t Q> void op_8xy6(const Instruction& in) {
+        auto& src = Has(Q, Quirks::SHIFT_VY) ? VY : VX;
+        VF = (src & 0x1); VX = src >> 1; }
+    void op_8xy7(const Instruction& in) { VF = (VY > VX); VX = VY - VX; }
+    template <std::uint8_t Q> void op_8xye(const Instruction& in) {
+        auto& src = Has(Q, Quirks::SHIFT_VY) ? VY : VX;
+        VF = (src & 0x80) >> 7; VX = src << 1; }
+    void op_9xy0(const Instruction& in) { if (VX != VY) PC += 0x02; }
+    void op_annn(const Instruction& in) { I = in.NNN; }
+    template <std::uint8_t Q> void op_bnnn(const Instruction& in) {
+        PC = (Has(Q, Quirks::JUMP_VX) ? VX : V[0x00]) + in.NNN; }
+    void op_cxnn(const Instruction& in) { VX = Random() & in.NN; }
+    void op_ex9e(const Instruction& in) { if ( hexpad.Down(VX)) PC += 0x02; }
+    void op_exa1(const Instruction& in) { if (!hexpad.Down(VX)) PC += 0x02; }
+    void op_fx07(const Instruction& in) { VX = DT; }
+    void op_fx15(const Instruction& in) { DT = VX; }
+    void op_fx18(const Instruction& in) { ST = VX; }
+    void op_fx1e(const Instruction& in) { I += VX; }
+    void op_fx29(const Instruction& in) { I = FONT_ADDRESS + (VX*5); }
+    void op_fx33(const Instruction& in) { Invalidate(I, 3);
+        memory[I]=VX/100; memory[I+1]=(VX%100)/10; memory[I+2]=VX%10; }
+    template <std::uint8_t Q> void op_fx55(const Instruction& in) { Invalidate(I, in.X+1);
+        std::copy_n(V.begin(), in.X+1, memory.begin()+I);
+        if constexpr (Has(Q, Quirks::INDEX)) I += in.X+1; }
+    template <std::uint8_t Q> void op_fx65(const Instruction& in) {
+        std::copy_n(memory.begin()+I, in.X+1, V.begin());
+        if constexpr (Has(Q, Quirks::INDEX)) I += in.X+1; }
+    void op_fx0a(const Instruction& in) {
+        auto key = hexpad.Take(); // A new press, not a key still held from before
+        if (key >= 0) VX = key; else PC -= 2; }
+    // Sprites are 8 pixels wide and N rows, or 16x16 for SUPER-CHIP's DXY0.
+    // They start at VX,VY modulo the screen, then wrap or are clipped.
+    template <std::uint8_t Q> void op_dxyn(const Instruction& in) {
+        if constexpr (Has(Q, Quirks::SCHIP)) if (hires) return DrawHires<Q>(in);
+        const bool big = Has(Q, Quirks::SCHIP) && in.N == 0;
+        const int  rows = big ? 16 : in.N;
+        auto x = VX % SCREEN_WIDTH, y = VY % SCREEN_HEIGHT;
+        std::uint64_t collision = 0;
+        for (int row = 0; row < rows; row++) {
+            if (Has(Q, Quirks::CLIP) && y + row >= SCREEN_HEIGHT) break;
+            std::uint64_t line = big
+                ? static_cast<std::uint64_t>(memory[(I + 2*row) & 0xfff] << 8 | memory[(I + 2*row + 1) & 0xfff]) << 48
+                : static_cast<std::uint64_t>(memory[(I + row) & 0xfff]) << 56;
+            if (Has(Q, Quirks::CLIP)) line >>= x;
+            else line = x ? (line >> x | line << (SCREEN_WIDTH - x)) : line; // Wraps
+            auto& dst = pixels[(y + row) % SCREEN_HEIGHT];
+            collision |= dst & line; // Any set pixel that gets cleared
+            dst ^= line;
+            dirty_rows |= 1u << (y + row) % SCREEN_HEIGHT;
+            PROFILE(profile.pixel_flips += __builtin_popcountll(line);)
+        }
+        VF = (collision != 0);
+        PROFILE(profile.collisions += VF;) }
+
+    // The same on the 128x64 plane, rows as 128-bit integers
+    template <std::uint8_t Q> void DrawHires(const Instruction& in) {
+        using Row = unsigned __int128;
+        const bool big = in.N == 0;
+        const int  rows = big ? 16 : in.N;
+        auto x = VX % HIRES_WIDTH, y = VY % HIRES_HEIGHT;
+        Row collision = 0;
+        for (int row = 0; row < rows; row++) {
+            if (Has(Q, Quirks::CLIP) && y + row >= HIRES_HEIGHT) break;
+            Row line = big
+                ? static_cast<Row>(memory[(I + 2*row) & 0xfff] << 8 | memory[(I + 2*row + 1) & 0xfff]) << 112
+                : static_cast<Row>(memory[(I + row) & 0xfff]) << 120;
+            if (Has(Q, Quirks::CLIP)) line >>= x;
+            else line = x ? (line >> x | line << (HIRES_WIDTH - x)) : line;
+            auto& dst = hires_pixels[(y + row) % HIRES_HEIGHT];
+            Row bits = static_cast<Row>(dst[0]) << 64 | dst[1];
+            collision |= bits & line;
+            bits ^= line;
+            dst = {static_cast<std::uint64_t>(bits >> 64), static_cast<std::uint64_t>(bits)};
+            dirty_rows |= 1u << (y + row) % HIRES_HEIGHT / 2;
+        }
+        VF = (collision != 0); }
+
+    // SUPER-CHIP only, no-ops otherwise. Scrolls move the plane shown by its
+    // own pixels: n rows down, 4 columns right or left.
+    template <std::uint8_t Q> void op_00cn(const Instruction& in) {
+        if constexpr (Has(Q, Quirks::SCHIP)) {
+            if (hires) Scroll(hires_pixels, in.N, HiresRow{ });
+            else       Scroll(pixels, in.N, std::uint64_t(0));
+            dirty_rows = ~0u; } }
+    template <std::uint8_t Q> void op_00fb(const Instruction&) {
+        if constexpr (Has(Q, Quirks::SCHIP)) {
+            if (hires) for (auto& row: hires_pixels) row = {row[0] >> 4, row[1] >> 4 | row[0] << 60};
+            else       for (auto& row: pixels) row >>= 4;
+            dirty_rows = ~0u; } }
+    template <std::uint8_t Q> void op_00fc(const Instruction&) {
+        if constexpr (Has(Q, Quirks::SCHIP)) {
+            if (hires) for (auto& row: hires_pixels) row = {row[0] << 4 | row[1] >> 60, row[1] << 4};
+            else       for (auto& row: pixels) row <<= 4;
+            dirty_rows = ~0u; } }
+    template <std::uint8_t Q> void op_00fd(const Instruction&) {
+        if constexpr (Has(Q, Quirks::SCHIP)) PC -= 2; } // Exit: stays on it
+    template <std::uint8_t Q> void op_00fe(const Instruction&) {
+        if constexpr (Has(Q, Quirks::SCHIP)) Resolution(false); }
+    template <std::uint8_t Q> void op_00ff(const Instruction&) {
+        if constexpr (Has(Q, Quirks::SCHIP)) Resolution(true); }
+    template <std::uint8_t Q> void op_fx30(const Instruction& in) {
+        if constexpr (Has(Q, Quirks::SCHIP)) I = BIG_FONT_ADDRESS + (VX & 0xf) * 10; }
+    template <std::uint8_t Q> void op_fx75(const Instruction& in) {
+        if constexpr (Has(Q, Quirks::SCHIP)) std::copy_n(V.begin(), in.X+1, flags.begin()); }
+    template <std::uint8_t Q> void op_fx85(const Instruction& in) {
+        if constexpr (Has(Q, Quirks::SCHIP)) std::copy_n(flags.begin(), in.X+1, V.begin()); }
+
+    // Both planes start blank after a switch
+    void Resolution(bool high) {
+        hires = high;
+        pixels.fill(0x00), hires_pixels.fill({ });
+        dirty_rows = ~0u;
+    }
+
+    template <typename Plane, typename Row>
+    static void Scroll(Plane& plane, std::size_t rows, Row blank) {
+        rows = std::min(rows, plane.size());
+        std::copy_backward(plane.begin(), plane.end() - rows, plane.end());
+        std::fill_n(plane.begin(), rows, blank);
+    }
 
-    using OpHashMap =
-        std::unordered_map<std::uint16_t, std::function<void()>>;
-
-    OpHashMap Dispatch = {
-        {0x0000, [this]() { void(this); }},
-        {0x00e0, [this]() { pixels.fill(0x00); }},
-        {0x00ee, [this]() { PC = stack.back(); stack.pop_back(); }},
-        {0x1000, [this]() { PC = NNN(OP); }},
-        {0x2000, [this]() { stack.push_back(PC); PC = NNN(OP); }},
-        {0x3000, [this]() { if (VX == NN(OP)) PC += 0x02; }},
-        {0x4000, [this]() { if (VX != NN(OP)) PC += 0x02; }},
-        {0x5000, [this]() { if (VX == VY) PC += 0x02; }},
-        {0x6000, [this]() { VX  = NN(OP); }},
-        {0x7000, [this]() { VX += NN(OP); }},
-        {0x8000, [this]() { VX  = VY; }},
-        {0x8001, [this]() { VX |= VY; }},
-        {0x8002, [this]() { VX &= VY; }},
-        {0x8003, [this]() { VX ^= VY; }},
-        {0x8004, [this]() { VF = (VX + VY > 0xff); VX = (VX + VY) & 0xff; }},
-        {0x8005, [this]() { VF = (VX > VY); VX -= VY; }},
-        {0x8006, [this]() { VF = (VX & 0x1); VX >>= 1; }},
-        {0x8007, [this]() { VF = (VY > VX); VX = VY - VX; }},
-        {0x800e, [this]() { VF = (VX & 0x80) >> 7; VX <<= 1; }},
-        {0x9000, [this]() { if (VX != VY) PC += 0x02; }},
-        {0xa000, [this]() { I = NNN(OP); }},
-        {0xb000, [this]() { PC = V[0x00] + NNN(OP); }},
-        {0xc000, [this]() { VX = ((rand() % 0xff + 1) & NN(OP)); }},
-        {0xe09e, [this]() { if ( hexpad.GetKey(VX)) { PC += 0x02; hexpad.Reset(); } }},
-        {0xe0a1, [this]() { if (!hexpad.GetKey(VX)) PC += 0x02; else hexpad.Reset(); }},
-        {0xf007, [this]() { VX = DT; }},
-        {0xf015, [this]() { DT = VX; }},
-        {0xf018, [this]() { ST = VX; }},
-        {0xf01e, [this]() { I += VX; }},
-        {0xf029, [this]() { I = FONT_ADDRESS + (VX*5); }},
-        {0xf033, [this]() { memory[I]=VX/100; memory[I+1]=(VX%100)/10; memory[I+2]=VX%10;}},
-        {0xf055, [this]() { std::copy_n(V.begin(), X(OP)+1, memory.begin()+I); }},
-        {0xf065, [this]() { std::copy_n(memory.begin()+I, X(OP)+1, V.begin()); }},
-        {0xf00a, [this]() {
-            auto i = std::distance(hexpad.keys.begin(),
-                std::find(hexpad.keys.begin(), hexpad.keys.end(), 1));
-            if (i != 16) VX = i; else PC -= 2; hexpad.Reset(); }},
-        {0xd000, [this]() { VF = 0x00;
-            for (int row = 0; row < N(OP); row++) {
-                auto byte = memory[I + row];
-                for (int col = 0; col < 8; col++)
-                    if (byte & (0x80 >> col)) {
-                        auto x = (VX+col) % SCREEN_WIDTH;
-                        auto y = (VY+row) % SCREEN_HEIGHT;
-                        auto idx = x + (y * SCREEN_WIDTH);
-                        auto tmp = pixels[idx];
-                        VF = (!(pixels[idx] ^= 0x01) && (tmp != pixels[idx]));
-                    }
-            }}}
-    };
+    void op_unknown(const Instruction&) { void(this); }
 };
@@ -1,83 +1,201 @@
 #include "Disassembler.hpp"
-#include <cstring>
-
-
-std::vector<std::string> Disassembler::Disassemble(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (file.is_open()) {
-        std::array<std::uint8_t, 4096> program = { };
-        auto bytes_size = static_cast<std::size_t>(file.read(
-            reinterpret_cast<char*>(program.data()), program.size()).gcount());
-        if (bytes_size > 4096 - 0x200)
-            throw std::runtime_error("Disassembler: Failed to fit ROM in memory");
-        std::uint16_t OP;
-        std::vector<std::string> lines;
-        for (std::uint16_t PC = 0; PC < bytes_size; PC+=2) {
-            OP = program[PC] << 8 | program[PC+1];
-            auto op_it = std::end(OpMap);
-            for (auto mask: {0xf0ff, 0xf00f, 0xf000}) {
-                if ((op_it = OpMap.find(OP & mask)) != std::end(OpMap)) {
-                    lines.push_back(fmt_op(op_it->second, OP));
-                    break;
-                }
-            }
+
+#include <algorithm>
+
+namespace {
+    enum : std::uint8_t { CODE = 0x1, START = 0x2 }; // Per ROM byte
+
+    constexpr std::size_t DATA_PER_LINE = 2; // Fits the TUI assembly panel, at most 3
+
+    inline char* Put(char* out, const char* text) {
+        while (*text) *out++ = *text++;
+        return out;
+    }
+
+    inline char* Hex(char* out, unsigned value, int digits) {
+        while (digits--) *out++ = "0123456789abcdef"[value >> digits*4 & 0xf];
+        return out;
+    }
+}
+
+std::vector<Disassembler::Line> Disassembler::Disassemble(const RomImage& rom) {
+    auto program = rom.Data();
+    auto size    = rom.Size();
+
+    // Follow every edge out of each reachable word, marking the bytes it covers
+    std::vector<std::uint8_t>  marks(size);
+    std::vector<std::uint16_t> work;
+    auto visit = [&](unsigned address) { // Whole words inside the ROM only
+        auto offset = address - ORIGIN;
+        if (address >= ORIGIN && offset+1 < size && !(marks[offset] & START))
+            work.push_back(address);
+    };
+    visit(ORIGIN); // Nothing to follow in ROMs under 2 bytes
+
+    while (!work.empty()) {
+        auto address = work.back(); work.pop_back();
+        auto offset  = address - ORIGIN;
+        if (marks[offset] & START) continue;
+
+        std::uint16_t OP = program[offset] << 8 | program[offset+1];
+        auto op = ::Decode(OP);
+        if (op == Opcode::UNKNOWN) continue;
+        marks[offset] |= CODE | START; marks[offset+1] |= CODE;
+
+        switch (op) {
+            case Opcode::RET:   case Opcode::EXIT:               break;
+            case Opcode::JP:    visit(NNN(OP));                  break;
+            case Opcode::JP_V0: visit(NNN(OP));                  break; // V0 == 0 at least
+            case Opcode::CALL:  visit(NNN(OP)); visit(address+2); break;
+            case Opcode::SE_VX_NN: case Opcode::SNE_VX_NN: case Opcode::SE_VX_VY:
+            case Opcode::SNE_VX_VY: case Opcode::SKP: case Opcode::SKNP:
+                visit(address+2); visit(address+4);              break;
+            default:            visit(address+2);                break;
+        }
+    }
+
+    // Instructions where decoding started, data runs everywhere else
+    std::vector<Line> lines;
+    lines.reserve(size/2 + 1);
+    for (std::size_t offset = 0; offset < size; offset += lines.back().size) {
+        if (marks[offset] & START) {
+            lines.push_back(Decode(ORIGIN + offset, program[offset] << 8 | program[offset+1]));
+            continue;
+        }
+        Line line;
+        line.address = ORIGIN + offset;
+        while (line.size < DATA_PER_LINE && offset+line.size < size
+               && !(marks[offset+line.size] & START))
+            line.args[line.size] = {Operand::BYTE, program[offset+line.size]}, line.size++;
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+std::size_t Disassembler::Find(const std::vector<Line>& lines, std::uint16_t address) {
+    auto it = std::upper_bound(lines.begin(), lines.end(), address,
+                               [](auto address, auto& line) { return address < line.address; });
+    if (it == lines.begin() || address >= (it-1)->address + (it-1)->size) return lines.size();
+    return std::distance(lines.begin(), it) - 1;
+}
+
+Disassembler::Line Disassembler::Decode(std::uint16_t address, std::uint16_t OP) {
+    Line line;
+    line.address = address;
+    line.OP      = OP;
+    line.op      = ::Decode(OP);
+    line.size    = 2;
+
+    auto& syntax = Syntaxes[static_cast<std::size_t>(line.op)];
+    for (auto i = 0; i < 3; i++) {
+        auto set = [&arg = line.args[i]](Operand type, unsigned value) {
+            arg.type = type, arg.value = value;
+        };
+        switch (syntax.fields[i]) {
+            case Field::NONE:     set(Operand::NONE,     0);       break;
+            case Field::X:        set(Operand::REGISTER, X(OP));   break;
+            case Field::Y:        set(Operand::REGISTER, Y(OP));   break;
+            case Field::V0:       set(Operand::REGISTER, 0);       break;
+            case Field::NNN:      set(Operand::ADDRESS,  NNN(OP)); break;
+            case Field::NN:       set(Operand::BYTE,     NN(OP));  break;
+            case Field::N:        set(Operand::NIBBLE,   N(OP));   break;
+            case Field::INDEX:    set(Operand::INDEX,    0);       break;
+            case Field::INDIRECT: set(Operand::INDIRECT, 0);       break;
+            case Field::DELAY:    set(Operand::DELAY,    0);       break;
+            case Field::SOUND:    set(Operand::SOUND,    0);       break;
+            case Field::KEY:      set(Operand::KEY,      0);       break;
+            case Field::FONT:     set(Operand::FONT,     0);       break;
+            case Field::BCD:      set(Operand::BCD,      0);       break;
+            case Field::HFONT:    set(Operand::HFONT,    0);       break;
+            case Field::FLAGS:    set(Operand::FLAGS,    0);       break;
         }
-        return lines;
-    } else throw std::runtime_error("Disassembler: Failed to open file");
-};
-
-std::string Disassembler::fmt_op(std::string fmt, std::uint16_t OP) {
-    for (auto sub: {"<reg_x>", "<reg_y>", "<addr>", "<byte>", "<nibble>"}) {
-        auto pos = fmt.find(sub);
-        if (pos != std::string::npos)
-            fmt.replace(pos, std::strlen(sub), ([OP](auto sub) {
-                char buffer[32];
-                if      (std::strcmp(sub, "<reg_x>" ) == 0) sprintf(buffer, "v%x"  , X(OP)  );
-                else if (std::strcmp(sub, "<reg_y>" ) == 0) sprintf(buffer, "v%x"  , Y(OP)  );
-                else if (std::strcmp(sub, "<addr>"  ) == 0) sprintf(buffer, "$%04x", NNN(OP));
-                else if (std::strcmp(sub, "<byte>"  ) == 0) sprintf(buffer, "$%02x", NN(OP) );
-                else if (std::strcmp(sub, "<nibble>") == 0) sprintf(buffer, "$%x"  , N(OP)  );
-                return std::string(buffer);
-            })(sub));
     }
-    return fmt;
-};
-
-const std::unordered_map<std::uint16_t, const char*>
-Disassembler::OpMap = {
-    {0x0000, "sys  <addr>"},
-    {0x00e0, "cls  "},
-    {0x00ee, "ret  "},
-    {0x1000, "jp   <addr>"},
-    {0x2000, "call <addr>"},
-    {0x3000, "se   <reg_x>,<byte>"},
-    {0x4000, "sne  <reg_x>,<byte>"},
-    {0x5000, "se   <reg_x>,<reg_y>"},
-    {0x6000, "ld   <reg_x>,<byte>"},
-    {0x7000, "add  <reg_x>,<byte>"},
-    {0x8000, "ld   <reg_x>,<reg_y>"},
-    {0x8001, "or   <reg_x>,<reg_y>"},
-    {0x8002, "and  <reg_x>,<reg_y>"},
-    {0x8003, "xor  <reg_x>,<reg_y>"},
-    {0x8004, "add  <reg_x>,<reg_y>"},
-    {0x8005, "sub  <reg_x>,<reg_y>"},
-    {0x8006, "shr  <reg_x>,{,<reg_y>}"},
-    {0x8007, "subn <reg_x>,<reg_y>"},
-    {0x800e, "shl  <reg_x>,{,<reg_y>}"},
-    {0x9000, "sne  <reg_x>,<reg_y>"},
-    {0xa000, "ld   I,<addr>"},
-    {0xb000, "jp   v0,<addr>"},
-    {0xc000, "rnd  <reg_x>,<byte>"},
-    {0xd000, "drw  <reg_x>,<reg_y>,<nibble>"},
-    {0xe09e, "skp  <reg_x>"},
-    {0xe0a1, "sknp <reg_x>"},
-    {0xf007, "ld   <reg_x>,DT"},
-    {0xf00a, "ld   <reg_x>,K"},
-    {0xf015, "ld   DT,<reg_x>"},
-    {0xf018, "ld   ST,<reg_x>"},
-    {0xf01e, "add  I,<reg_x>"},
-    {0xf029, "ld   F,<reg_y>"},
-    {0xf033, "ld   B,<reg_x>"},
-    {0xf055, "ld   [I],<reg_x>"},
-    {0xf065, "ld   <reg_x>,[I]"}
-};
+    return line;
+}
+
+const char* Disassembler::Mnemonic(const Line& line) {
+    return line.code() ? Syntaxes[static_cast<std::size_t>(line.op)].mnemonic : "db";
+}
+
+std::size_t Disassembler::Format(const Argument& arg, char* out) {
+    auto begin = out;
+    switch (arg.type) {
+        case Operand::REGISTER: *out++ = 'v'; out = Hex(out, arg.value, 1); break;
+        case Operand::ADDRESS:  *out++ = '$'; out = Hex(out, arg.value, 4); break;
+        case Operand::BYTE:     *out++ = '$'; out = Hex(out, arg.value, 2); break;
+        case Operand::NIBBLE:   *out++ = '$'; out = Hex(out, arg.value, 1); break;
+        case Operand::INDEX:    out = Put(out, "I");                        break;
+        case Operand::INDIRECT: out = Put(out, "[I]");                      break;
+        case Operand::DELAY:    out = Put(out, "DT");                       break;
+        case Operand::SOUND:    out = Put(out, "ST");                       break;
+        case Operand::KEY:      out = Put(out, "K");                        break;
+        case Operand::FONT:     out = Put(out, "F");                        break;
+        case Operand::BCD:      out = Put(out, "B");                        break;
+        case Operand::HFONT:    out = Put(out, "HF");                       break;
+        case Operand::FLAGS:    out = Put(out, "R");                        break;
+        case Operand::NONE:                                                 break;
+    }
+    *out = '\0';
+    return out - begin;
+}
+
+std::size_t Disassembler::Format(const Line& line, char* out) {
+    auto begin = out;
+    out = Put(out, Mnemonic(line));
+    while (out - begin < 5) *out++ = ' ';
+    for (auto i = 0; i < 3 && line.args[i].type != Operand::NONE; i++) {
+        if (i) *out++ = ',';
+        out += Format(line.args[i], out);
+    }
+    *out = '\0';
+    return out - begin;
+}
+
+const std::array<Disassembler::Syntax, OPCODE_COUNT>
+Disassembler::Syntaxes = {{
+    {"sys",  {Field::NNN}},
+    {"cls",  {}},
+    {"ret",  {}},
+    {"jp",   {Field::NNN}},
+    {"call", {Field::NNN}},
+    {"se",   {Field::X, Field::NN}},
+    {"sne",  {Field::X, Field::NN}},
+    {"se",   {Field::X, Field::Y}},
+    {"ld",   {Field::X, Field::NN}},
+    {"add",  {Field::X, Field::NN}},
+    {"ld",   {Field::X, Field::Y}},
+    {"or",   {Field::X, Field::Y}},
+    {"and",  {Field::X, Field::Y}},
+    {"xor",  {Field::X, Field::Y}},
+    {"add",  {Field::X, Field::Y}},
+    {"sub",  {Field::X, Field::Y}},
+    {"shr",  {Field::X, Field::Y}},
+    {"subn", {Field::X, Field::Y}},
+    {"shl",  {Field::X, Field::Y}},
+    {"sne",  {Field::X, Field::Y}},
+    {"ld",   {Field::INDEX, Field::NNN}},
+    {"jp",   {Field::V0, Field::NNN}},
+    {"rnd",  {Field::X, Field::NN}},
+    {"drw",  {Field::X, Field::Y, Field::N}},
+    {"skp",  {Field::X}},
+    {"sknp", {Field::X}},
+    {"ld",   {Field::X, Field::DELAY}},
+    {"ld",   {Field::X, Field::KEY}},
+    {"ld",   {Field::DELAY, Field::X}},
+    {"ld",   {Field::SOUND, Field::X}},
+    {"add",  {Field::INDEX, Field::X}},
+    {"ld",   {Field::FONT, Field::X}},
+    {"ld",   {Field::BCD, Field::X}},
+    {"ld",   {Field::INDIRECT, Field::X}},
+    {"ld",   {Field::X, Field::INDIRECT}},
+    {"scd",  {Field::N}},                  // SUPER-CHIP
+    {"scr",  {}},
+    {"scl",  {}},
+    {"exit", {}},
+    {"low",  {}},
+    {"high", {}},
+    {"ld",   {Field::HFONT, Field::X}},
+    {"ld",   {Field::FLAGS, Field::X}},
+    {"ld",   {Field::X, Field::FLAGS}},
+    {"db",   {}},                          // UNKNOWN, listed as data
+}};
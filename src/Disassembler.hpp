@@ -1,12 +1,12 @@
 #pragma once
 
+#include "Opcode.hpp"
+#include "RomImage.hpp"
+
 #include <vector>
-#include <string>
 #include <array>
-#include <exception>
-#include <fstream>
-#include <unordered_map>
-#include <cstring>
+#include <cstdint>
+#include <cstddef>
 
 #define N(bytes)    ( bytes & 0x000f)        // ...N
 #define NN(bytes)   ( bytes & 0x00ff)        // ..NN
@@ -16,13 +16,58 @@
 
 class Disassembler final {
 public:
-    static std::vector<std::string> Disassemble(const std::string& filename);
+    static constexpr std::uint16_t ORIGIN = 0x200; // Where the ROM is loaded
+
+    enum class Operand : std::uint8_t {
+        NONE,
+        REGISTER, ADDRESS, BYTE, NIBBLE,              // Carry a value
+        INDEX, INDIRECT, DELAY, SOUND, KEY, FONT, BCD, // I, [I], DT, ST, K, F, B
+        HFONT, FLAGS                                   // HF, R (SUPER-CHIP)
+    };
+
+    struct Argument {
+        Operand       type  = Operand::NONE;
+        std::uint16_t value = 0;
+    };
+
+    // One listing entry: a decoded instruction, or up to two data bytes
+    // (op == UNKNOWN) kept as BYTE arguments.
+    struct Line {
+        std::uint16_t           address = 0;
+        std::uint16_t           OP      = 0;
+        Opcode                  op      = Opcode::UNKNOWN;
+        std::uint8_t            size    = 0; // Bytes covered
+        std::array<Argument, 3> args    = { };
+
+        bool code() const { return op != Opcode::UNKNOWN; }
+    };
+
+    // Recursive descent from ORIGIN: only words reachable through jp, call
+    // and skip edges are decoded, every other byte is listed as data.
+    static std::vector<Line> Disassemble(const RomImage& rom);
+
+    // Index of the line covering `address`, lines.size() if there is none
+    static std::size_t Find(const std::vector<Line>& lines, std::uint16_t address);
+
+    static Line Decode(std::uint16_t address, std::uint16_t OP);
+
+    static const char* Mnemonic(const Line& line); // "ld", "drw", "db"...
+
+    // Write text to `out` ("v3", "$02", "[I]" / "ld   v3,$02"), return the length
+    static std::size_t Format(const Argument& arg, char* out);
+    static std::size_t Format(const Line& line, char* out);
 
 private:
     Disassembler() = default;
 
-    static std::string fmt_op(std::string fmt, std::uint16_t OP);
-    static const std::unordered_map<std::uint16_t, const char*> OpMap;
+    // Where each operand of an opcode comes from
+    enum class Field : std::uint8_t {
+        NONE, X, Y, V0, NNN, NN, N, INDEX, INDIRECT, DELAY, SOUND, KEY, FONT, BCD, HFONT, FLAGS
+    };
 
+    struct Syntax {
+        const char* mnemonic;
+        Field       fields[3];
+    };
+    static const std::array<Syntax, OPCODE_COUNT> Syntaxes;
 };
-
@@ -1,8 +1,8 @@
 #include "Display.hpp"
 
 
-Display::Display(Chip8& c8)
-: c8(c8), assembly(Disassembler::Disassemble(c8.filename)) {
+Display::Display(Emulator& emulator)
+: emulator(emulator), assembly(Disassembler::Disassemble(emulator.Rom())) {
 
     std::setlocale(LC_ALL, "en_US.UTF-8"); // Proper unicode
     initscr();                             // Init ncurses
@@ -21,6 +21,10 @@ Display::Display(Chip8& c8)
     main  = newwin(SCREEN_HEIGHT/2+2, SCREEN_WIDTH+2, 0, 23);    // Emulator
     right = newwin(SCREEN_HEIGHT/2+2, 23, 0, SCREEN_WIDTH+2+23); // Assembly
 
+    PROFILE( // Hot addresses, when the terminal is wide enough
+        if (COLS >= SCREEN_WIDTH+2+23*3)
+            heat = newwin(SCREEN_HEIGHT/2+2, 23, 0, SCREEN_WIDTH+2+23*2);)
+
     wattrset(left, A_BOLD);
     wattrset(main, A_BOLD);
     wattrset(right, A_BOLD);
@@ -40,59 +44,144 @@ Display::Display(Chip8& c8)
     init_pair(8, 223, -1);  // HEX ASM
     init_pair(9, 230, -1);  // OTHER ASM
 
-    // assembly = Disassembler::Disassemble(c8.filename);
+    int shades[] = { 233, 22, 28, 34, 40, 46 };
+    for (int i = 0; i < 6; i++)
+        init_pair(10+i, -1, shades[i]); // HEATMAP, coldest to hottest
 }
 
 Display::~Display() { endwin(); }
 
-void Display::Refresh() const {
+void Display::Refresh() {
     UserInput();
+    frame = &emulator.Latest();
     LeftPannel();
     MainPannel();
     RightPannel();
-    refresh();
+    PROFILE(HeatPannel();)
+    doupdate();
+    full_redraw = false;
+
+    // On screen now: the time since the key press it answers is the latency
+    if (frame->responded != responded) {
+        responded = frame->responded;
+        latency   = (Emulator::Now() - responded) / 1000000;
+    }
 }
 
 
-void Display::UserInput() const {
-    int input = getch();
-
-    if (input == ERR) return;
-
-    if      (input == 27)  c8.quit   = true;                                            // Del
-    else if (input == 32 ) c8.paused ^= 1;                                              // Space
-    else if (input == 9  ) c8.step   = true;                                            // Tab
-    else if (input == 10 ) c8.Reset();                                                  // Enter
-    else if (input == 45 ) c8.cycle_speed -= c8.cycle_speed > 20.0f   ? 20.0f : 0.0f;   // Minus
-    else if (input == 43 ) c8.cycle_speed += c8.cycle_speed < 9000.0f ? 20.0f : 0.0f;   // Plus
-    else                   c8.hexpad.SetKey(input);                                     // Hexpad
+void Display::UserInput() {
+    using Command = Emulator::Command;
+    auto send = [this](Command::Type type, char key = 0) { emulator.Send({type, key, Emulator::Now()}); };
+
+    for (int input; (input = getch()) != ERR; ) {
+        if      (input == 27)  send(Command::QUIT);                                          // Del
+        else if (input == 32 ) send(Command::PAUSE);                                         // Space
+        else if (input == 9  ) send(Command::STEP);                                          // Tab
+        else if (input == 10 ) send(Command::RESET), full_redraw = true;                     // Enter
+        else if (input == 45 ) send(Command::SLOWER);                                        // Minus
+        else if (input == 43 ) send(Command::FASTER);                                        // Plus
+        else if (input == 'm') send(Command::UNTHROTTLE);                                    // Max speed
+        else if (input == KEY_BACKSPACE || input == 127) send(Command::REWIND);              // Backspace
+        else if (input == KEY_F(5)) send(Command::SAVE);                                     // F5
+        else if (input == KEY_F(6)) send(Command::TRACE);                                    // F6
+        else if (input == KEY_F(9)) send(Command::LOAD), full_redraw = true;                 // F9
+        else if (input == 'b') send(Command::BREAK);                                         // At PC
+        else if (input == 'n') send(Command::WATCH);                                         // Writes at I
+        else                   send(Command::KEY, static_cast<char>(input));                 // Hexpad
+    }
 }
 
 // Emulator
-void Display::MainPannel() const {
-    if (c8.ST > 0) wattron(main, COLOR_PAIR(6)); // Color box for sound timer
-    box(main,  0, 0);
-    mvwprintw(main, 0, 2, "[%s]", c8.filename.c_str());
-    mvwprintw(main, 17, 2,
-        "[esc->quit]─[enter->reset]─[spc->pause]─[tab->step]─[-%.0fHz+]", c8.cycle_speed);
+void Display::MainPannel() {
+    // Measured instructions per second, sampled once per second
+    static auto     ips_tick   = std::chrono::steady_clock::now();
+    static auto     ips_cycles = frame->cycles;
+    static unsigned ips        = 0;
+    auto now = std::chrono::steady_clock::now();
+    if (now - ips_tick >= std::chrono::seconds(1)) {
+        ips = (frame->cycles - ips_cycles) /
+            std::chrono::duration<double>(now - ips_tick).count();
+        ips_tick = now, ips_cycles = frame->cycles;
+    }
+
+    // Frame and labels, only when something on them changed
+    bool sound = frame->ST > 0;
+    auto speed = frame->unthrottled ? -1.f : frame->cycle_speed;
+    auto& fault = frame->fault;
+    if (full_redraw || sound != drawn.sound || ips != drawn.ips || speed != drawn.speed || fault != drawn.fault ||
+        latency != drawn.latency) {
+        if (sound) wattron(main, COLOR_PAIR(6)); // Color box for sound timer
+        box(main,  0, 0);
+        mvwprintw(main, 0, 2, "[%s]", emulator.Rom().Filename().c_str());
+        if (frame->quirks != Quirks::DEFAULT) wprintw(main, "─[%s]", Quirks::Name(frame->quirks).c_str());
+        if (frame->fault[0]) wprintw(main, "─[%s]", frame->fault.data() + 7); // Past "chip8: "
+        mvwprintw(main, 0, SCREEN_WIDTH-24, "[in %4ums]─[%5u ips]", std::min(latency, 9999u), ips);
+        mvwprintw(main, 17, 2, "[esc->quit]─[enter->reset]─[spc->pause]─[tab->step]─");
+        wprintw(main, frame->unthrottled ? "[max]" : "[-%.0fHz+]", frame->cycle_speed);
+        wattroff(main, COLOR_PAIR(6));
+        drawn.sound = sound, drawn.ips = ips, drawn.speed = speed, drawn.fault = fault;
+        drawn.latency = latency;
+    }
+
+    bool redraw = full_redraw || frame->hires != drawn.hires;
+    drawn.hires = frame->hires;
+    if (frame->hires) { HiresScreen(redraw); wnoutrefresh(main); return; }
 
     // halfblock char + bg color for correct aspect ratio
+    // Only the cells that differ from what is on screen: frames the terminal
+    // was too slow for are skipped, so it diffs against its own copy
     for (int row = 0; row < SCREEN_HEIGHT; row+=2) {
-        for (int col = 0; col < SCREEN_WIDTH; col++) {
-            auto pixel_top = c8.GetPixel(col, row  );
-            auto pixel_bot = c8.GetPixel(col, row+1);
-            auto color = (pixel_bot << 1 | pixel_top) + 1;
+        auto top = frame->pixels[row], bot = frame->pixels[row+1];
+        auto changed = (top ^ drawn.pixels[row]) | (bot ^ drawn.pixels[row+1]);
+        if (redraw) changed = ~0ull;
+        drawn.pixels[row] = top, drawn.pixels[row+1] = bot;
+        for (; changed; changed &= changed - 1) {
+            int col = 63 - __builtin_ctzll(changed); // Lowest set bit is the rightmost cell
+            auto color = ((bot << col >> 63) << 1 | (top << col >> 63)) + 1;
             wattron(main, COLOR_PAIR(color));
             mvwaddwstr(main, row/2+1, col+1, L"▄");
             wattroff(main, COLOR_PAIR(color));
         }
     }
-    wrefresh(main);
+    wnoutrefresh(main);
+}
+
+// SUPER-CHIP 128x64 in the same 64x16 cells: a braille character holds 2x4
+// pixels, its dots numbered down the left column then down the right, with
+// the bottom row last
+void Display::HiresScreen(bool redraw) {
+    static constexpr std::uint8_t dots[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+    auto pixel = [this](int x, int y) { return frame->hires_pixels[y][x / 64] >> (63 - x % 64) & 1; };
+
+    wattron(main, COLOR_PAIR(3));
+    for (int row = 0; row < HIRES_HEIGHT; row += 4) {
+        for (int word = 0; word < 2; word++) {
+            std::uint64_t changed = redraw ? ~0ull : 0;
+            for (int y = row; y < row + 4; y++) {
+                changed |= frame->hires_pixels[y][word] ^ drawn.hires_pixels[y][word];
+                drawn.hires_pixels[y][word] = frame->hires_pixels[y][word];
+            }
+            for (; changed; changed &= ~(3ull << (__builtin_ctzll(changed) & ~1))) { // Both columns of a cell
+                int x = (word * 64 + 63 - __builtin_ctzll(changed)) & ~1;
+                wchar_t cell[2] = {0x2800, 0};
+                for (int dy = 0; dy < 4; dy++)
+                    for (int dx = 0; dx < 2; dx++)
+                        if (pixel(x + dx, row + dy)) cell[0] |= dots[dy][dx];
+                mvwaddwstr(main, row/4+1, x/2+1, cell);
+            }
+        }
+    }
+    wattroff(main, COLOR_PAIR(3));
 }
 
 // Variables
-void Display::LeftPannel() const {
-    auto field = [this](int y, int x1, const char* name, int x2, int val, int hex_f=0x02) {
+void Display::LeftPannel() {
+    int slot = 0; // Position of the field in drawn.fields
+
+    auto field = [this, &slot](int y, int x1, const char* name, int x2, int val, int hex_f=0x02) {
+        auto& old = drawn.fields[slot++];
+        if (!full_redraw && old == val) return;
+        old = val;
         wattron(left, COLOR_PAIR(5));
         mvwprintw(left, y, x1, name);
         wattron(left, COLOR_PAIR(6));
@@ -101,106 +190,152 @@ void Display::LeftPannel() const {
     };
 
     auto sep = [this](int y, int x, const char* wchar) {
-        mvwprintw(left, y, x, wchar);
+        if (full_redraw) mvwprintw(left, y, x, wchar);
     };
 
     auto stack_val = [this](int depth) {
-        return ((int)c8.stack.size() >= depth) ? c8.stack.back()-depth : 0xdead;
+        return (frame->depth >= depth) ? frame->stack[frame->depth-depth] : 0xdead;
     };
 
     auto keypad_row_keys =
-        [this](int n, const char* k1, const char* k2, const char* k3, const char* k4) {
+        [this, &slot](int n, const char* k1, const char* k2, const char* k3, const char* k4) {
             int i = 0;
             for (auto k: {k1, k2, k3, k4}) {
-                wattron(left, COLOR_PAIR(c8.hexpad.GetKeyFromMap((char)k[0]) ? 5 : 6));
-                mvwprintw(left, 13+n, 13+i, k); i+=2;
+                int pressed = Keyboard::IsDown(frame->keys[Keyboard::Map(k[0])]);
+                auto& old = drawn.fields[slot++];
+                if (full_redraw || old != pressed) {
+                    wattron(left, COLOR_PAIR(pressed ? 5 : 6));
+                    mvwprintw(left, 13+n, 13+i, k);
+                    old = pressed;
+                } i+=2;
             } wattroff(left, COLOR_PAIR(6));
         };
 
-    werase(left);
-    box(left,  0, 0);
-
-    mvwprintw(left, 0, 3, "┐REG┌──┬");                 mvwprintw(left, 0, 12, "┐VARIOUS┌");
-    field(1 , 2, "v0", 5, c8.V[0]);  sep(1 , 10, "│"); field(1 , 12, "OP", 15, c8.OP, 0x04);
-    field(2 , 2, "v1", 5, c8.V[1]);  sep(2 , 10, "│"); field(2 , 12, "PC", 15, c8.PC-2, 0x04);
-    field(3 , 2, "v2", 5, c8.V[2]);  sep(3 , 10, "│"); field(3 , 12, "I",  15, c8.I, 0x04);
-    field(4 , 2, "v3", 5, c8.V[3]);  sep(4 , 10, "│"); field(4 , 12, "DT", 15, c8.DT, 0x04);
-    field(5 , 2, "v4", 5, c8.V[4]);  sep(5 , 10, "│"); field(5 , 12, "ST", 15, c8.ST, 0x04);
-    field(6 , 2, "v5", 5, c8.V[5]);  sep(6 , 10, "│"); mvwprintw(left, 6 , 11, "──┐STACK┌──");
-    field(7 , 2, "v6", 5, c8.V[6]);  sep(7 , 10, "│"); field(7 , 12, "s1", 15, stack_val(1), 0x04);
-    field(8 , 2, "v7", 5, c8.V[7]);  sep(8 , 10, "│"); field(8 , 12, "s2", 15, stack_val(2), 0x04);
-    field(9 , 2, "v8", 5, c8.V[8]);  sep(9 , 10, "│"); field(9 , 12, "s3", 15, stack_val(3), 0x04);
-    field(10, 2, "v9", 5, c8.V[9]);  sep(10, 10, "│"); field(10, 12, "s4", 15, stack_val(4), 0x04);
-    field(11, 2, "va", 5, c8.V[10]); sep(11, 10, "│"); field(11, 12, "s5", 15, stack_val(5), 0x04);
-    field(12, 2, "vb", 5, c8.V[11]); sep(12, 10, "│"); mvwprintw(left, 12, 11, "───┐PAD┌───");
-    field(13, 2, "vc", 5, c8.V[12]); sep(13, 10, "│"); keypad_row_keys(0, "1 ", "2 ", "3 ", "4");
-    field(14, 2, "vd", 5, c8.V[13]); sep(14, 10, "│"); keypad_row_keys(1, "q ", "w ", "e ", "r");
-    field(15, 2, "ve", 5, c8.V[14]); sep(15, 10, "│"); keypad_row_keys(2, "a ", "s ", "d ", "f");
-    field(16, 2, "vf", 5, c8.V[15]); sep(16, 10, "│"); keypad_row_keys(3, "z ", "x ", "c ", "v");
-    mvwprintw(left, 6 ,  10, "├"); mvwprintw(left, 6 , 22, "┤");
-    mvwprintw(left, 12,  10, "├"); mvwprintw(left, 12, 22, "┤");
-    mvwprintw(left, 17, 10, "┴");
-
-    wrefresh(left);
+    if (full_redraw) {
+        werase(left);
+        box(left,  0, 0);
+        mvwprintw(left, 0, 3, "┐REG┌──┬");             mvwprintw(left, 0, 12, "┐VARIOUS┌");
+        mvwprintw(left, 6 , 11, "──┐STACK┌──");
+        mvwprintw(left, 12, 11, "───┐PAD┌───");
+    }
+
+    field(1 , 2, "v0", 5, frame->V[0]);  sep(1 , 10, "│"); field(1 , 12, "OP", 15, frame->OP, 0x04);
+    field(2 , 2, "v1", 5, frame->V[1]);  sep(2 , 10, "│"); field(2 , 12, "PC", 15, Current(), 0x04);
+    field(3 , 2, "v2", 5, frame->V[2]);  sep(3 , 10, "│"); field(3 , 12, "I",  15, frame->I, 0x04);
+    field(4 , 2, "v3", 5, frame->V[3]);  sep(4 , 10, "│"); field(4 , 12, "DT", 15, frame->DT, 0x04);
+    field(5 , 2, "v4", 5, frame->V[4]);  sep(5 , 10, "│"); field(5 , 12, "ST", 15, frame->ST, 0x04);
+    field(6 , 2, "v5", 5, frame->V[5]);  sep(6 , 10, "│");
+    field(7 , 2, "v6", 5, frame->V[6]);  sep(7 , 10, "│"); field(7 , 12, "s1", 15, stack_val(1), 0x04);
+    field(8 , 2, "v7", 5, frame->V[7]);  sep(8 , 10, "│"); field(8 , 12, "s2", 15, stack_val(2), 0x04);
+    field(9 , 2, "v8", 5, frame->V[8]);  sep(9 , 10, "│"); field(9 , 12, "s3", 15, stack_val(3), 0x04);
+    field(10, 2, "v9", 5, frame->V[9]);  sep(10, 10, "│"); field(10, 12, "s4", 15, stack_val(4), 0x04);
+    field(11, 2, "va", 5, frame->V[10]); sep(11, 10, "│"); field(11, 12, "s5", 15, stack_val(5), 0x04);
+    field(12, 2, "vb", 5, frame->V[11]); sep(12, 10, "│");
+    field(13, 2, "vc", 5, frame->V[12]); sep(13, 10, "│"); keypad_row_keys(0, "1 ", "2 ", "3 ", "4");
+    field(14, 2, "vd", 5, frame->V[13]); sep(14, 10, "│"); keypad_row_keys(1, "q ", "w ", "e ", "r");
+    field(15, 2, "ve", 5, frame->V[14]); sep(15, 10, "│"); keypad_row_keys(2, "a ", "s ", "d ", "f");
+    field(16, 2, "vf", 5, frame->V[15]); sep(16, 10, "│"); keypad_row_keys(3, "z ", "x ", "c ", "v");
+    sep(6 ,  10, "├"); sep(6 , 22, "┤");
+    sep(12,  10, "├"); sep(12, 22, "┤");
+    sep(17, 10, "┴");
+
+    wnoutrefresh(left);
 }
 
 // Assembly
-void Display::RightPannel() const {
+void Display::RightPannel() {
 
-    auto idx = std::abs(c8.PC-2 - ENTRY_POINT) / 2;
+    // Line of the instruction that just ran, assembly.size() outside the ROM
+    int idx = Disassembler::Find(assembly, Current());
     static int old_idx;
 
-    auto format_assembly = [this, idx](auto offset) {
-        auto line = assembly[idx+offset];
+    auto format_assembly = [this](auto offset) {
+        auto& line = assembly[old_idx+offset];
 
-        // Address
+        // Breakpoint, address
+        if (frame->breakpoints[line.address & 0xfff]) {
+            wattron(right, COLOR_PAIR(6));
+            mvwaddstr(right, offset+1, 1, "●");
+        }
         wattron(right, COLOR_PAIR(5));
-        mvwprintw(right, offset+1, 2, "%04x", (c8.PC-2)+offset*2);
+        mvwprintw(right, offset+1, 2, "%04x", line.address);
 
         // Mmemonics
         wattron(right, COLOR_PAIR(6));
-        mvwprintw(right, offset+1, 7,  "%s", std::string(line.begin(), line.begin()+4).c_str());
-
-        // Split Arguments
-        auto begin = 0;
-        auto args = std::string(line.begin()+5, line.end());
-        auto tokens = std::vector<std::string>(); tokens.reserve(3);
-        for (auto end=0; (size_t)(end = args.find(',', end)) != std::string::npos; ++end) {
-            tokens.push_back(args.substr(begin, end-begin));
-            begin = end+1;
-        } tokens.push_back(args.substr(begin));
-
-        // Print Arguments
-        auto args_offset = 0; auto count = 0;
-        for (auto token: tokens) {
-            auto color = 0;
-
-            if      (token[0] == 'v') color = 7;
-            else if (token[0] == '$') color = 8;
-            else                      color = 9;
-
+        mvwprintw(right, offset+1, 7, "%-4s", Disassembler::Mnemonic(line));
+
+        // Arguments, colored by operand type
+        char text[8];
+        wmove(right, offset+1, 13);
+        for (auto i = 0; i < 3 && line.args[i].type != Disassembler::Operand::NONE; i++) {
+            auto length = Disassembler::Format(line.args[i], text);
+            if (i < 2 && line.args[i+1].type != Disassembler::Operand::NONE)
+                text[length++] = ',', text[length] = '\0';
+            auto color = 9;
+            switch (line.args[i].type) {
+                case Disassembler::Operand::REGISTER: color = 7; break;
+                case Disassembler::Operand::ADDRESS:
+                case Disassembler::Operand::BYTE:
+                case Disassembler::Operand::NIBBLE:   color = 8; break;
+                default:                              break;
+            }
             wattron(right, COLOR_PAIR(color));
-            mvwprintw(right, offset+1, 13+args_offset, "%s%c", token.c_str(),
-                      (count++ < (int)tokens.size()-1 ? ',' : 0));
-            args_offset += token.length()+1;
+            waddstr(right, text);
             wattroff(right, COLOR_PAIR(color));
         }
     };
 
-    // Only refresh if current instruction isn't on screen already
-    if (idx < old_idx || (idx - old_idx) > 15 || idx == 0) {
+    // Only refresh if current instruction isn't on screen already, or a
+    // breakpoint came or went
+    bool scroll = full_redraw || idx < old_idx || (idx - old_idx) > 15 || idx == 0;
+    if (scroll || frame->breakpoints != drawn.breakpoints) {
         werase(right);
+        if (scroll) old_idx = idx;
+        drawn.breakpoints = frame->breakpoints;
         for (auto i = 0; i < 16; i++)
-            if (idx+i < (int)assembly.size())
+            if (old_idx+i < (int)assembly.size())
                 format_assembly(i);
-        old_idx = idx;
     }
 
     box(right, 0, 0);
     mvwprintw(right, 0 , 1, "┐ASSEMBLY┌");
 
     // Highlight current instruction
-    mvwchgat(right, idx-old_idx+1, 7, 4, A_STANDOUT | A_BOLD | A_DIM, 6, nullptr);
-    wrefresh(right);
-    mvwchgat(right, idx-old_idx+1, 7, 4, A_BOLD, 6, nullptr);
+    auto shown = idx < (int)assembly.size();
+    if (shown) mvwchgat(right, idx-old_idx+1, 7, 4, A_STANDOUT | A_BOLD | A_DIM, 6, nullptr);
+    wnoutrefresh(right);
+    if (shown) mvwchgat(right, idx-old_idx+1, 7, 4, A_BOLD, 6, nullptr);
+}
+
+#ifdef CHIP8_PROFILE
+// Hot addresses: each cell sums the executions of 16 bytes of the program
+// area (0x200-0xfff), shaded on a log scale relative to the hottest cell.
+void Display::HeatPannel() {
+    if (!heat) return;
+
+    constexpr int rows = SCREEN_HEIGHT/2, cols = 14, bytes = 16;
+    std::array<std::uint64_t, rows*cols> cells = { };
+    std::uint64_t hottest = 1;
+    for (int cell = 0; cell < rows*cols; cell++) {
+        auto first = frame->addresses.begin() + ENTRY_POINT + cell*bytes;
+        cells[cell] = std::accumulate(first, first + bytes, std::uint64_t(0));
+        hottest = std::max(hottest, cells[cell]);
+    }
+
+    box(heat, 0, 0);
+    mvwprintw(heat, 0, 1, "┐HEAT┌");
+    for (int row = 0; row < rows; row++) {
+        wattron(heat, COLOR_PAIR(5));
+        mvwprintw(heat, row+1, 2, "%03x", ENTRY_POINT + row*cols*bytes);
+        wattroff(heat, COLOR_PAIR(5));
+        for (int col = 0; col < cols; col++) {
+            auto count = cells[row*cols + col];
+            int shade = count ? 1 + std::log2(count) / std::log2(hottest+1) * 5 : 0;
+            wattron(heat, COLOR_PAIR(10 + std::min(shade, 5)));
+            mvwaddch(heat, row+1, 6+col, ' ');
+            wattroff(heat, COLOR_PAIR(10 + std::min(shade, 5)));
+        }
+    }
+    wnoutrefresh(heat);
 }
+#endif
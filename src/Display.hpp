@@ -2,32 +2,63 @@
 
 #include "Chip8.hpp"
 #include "Disassembler.hpp"
+#include "Emulator.hpp"
 
 #include <vector>
 #include <string>
 #include <array>
+#include <bitset>
+#include <cmath>
+#include <numeric>
 #include "ncurses.h"
 
+// ncurses front end, on the UI thread: draws the newest Snapshot published
+// by the Emulator and sends it the keys pressed as Commands, stamped with
+// when they were read to measure the latency to the screen.
 class Display final {
 
 public:
-     Display(Chip8& c8);
+     Display(Emulator& emulator);
     ~Display();
 
-    void Refresh() const;
+    void Refresh(); // At most once per terminal frame
 
 private:
-    Chip8& c8;
+    Emulator&       emulator;
+    const Snapshot* frame = nullptr; // Being drawn
 
     WINDOW*      left;
     WINDOW*      main;
     WINDOW*      right;
+    WINDOW*      heat = nullptr; // Profile builds only
 
-    std::vector<std::string> assembly;
+    std::vector<Disassembler::Line> assembly;
 
-    void UserInput() const;
+    // What is currently on screen, only what differs from it gets redrawn
+    struct Drawn {
+        std::array<std::uint64_t, SCREEN_HEIGHT> pixels = { };
+        std::array<HiresRow, HIRES_HEIGHT>       hires_pixels = { };
+        bool     hires   = false;
+        std::array<int, 48>                      fields = { }; // LeftPannel
+        bool     sound   = false;
+        std::array<char, 32> fault = { };
+        std::bitset<4096>    breakpoints; // RightPannel
+        unsigned ips     = 0;
+        float    speed   = 0.f;
+        unsigned latency = 0; // ms
+    } drawn;
+    bool full_redraw = true;
+    std::uint64_t responded = 0; // Last Snapshot::responded seen
+    unsigned      latency   = 0; // Key press to the frame showing its effect, ms
 
-    void LeftPannel() const;
-    void MainPannel() const;
-    void RightPannel() const;
+    void UserInput(); // Every key waiting in the terminal
+
+    // The instruction that just ran, or the one that trapped
+    int Current() const { return frame->fault[0] ? frame->PC : frame->PC-2; }
+
+    void LeftPannel();
+    void MainPannel();
+    void HiresScreen(bool redraw); // MainPannel() in SUPER-CHIP 128x64 mode
+    void RightPannel();
+    PROFILE(void HeatPannel();)
 };
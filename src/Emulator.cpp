@@ -0,0 +1,108 @@
+#include "Emulator.hpp"
+#include "Breakpoints.hpp"
+#include "Scheduler.hpp"
+#include "Trace.hpp"
+
+#include <chrono>
+
+// A press nothing answers within this long (not a key of this ROM) is dropped
+constexpr std::uint64_t PENDING_NS = 1000000000;
+
+Emulator::Emulator(Chip8& c8, FrameExport* output): c8(c8), output(output) {
+    c8.Capture(frames.Back());
+    frames.Publish();
+    thread = std::thread(&Emulator::Loop, this);
+}
+
+Emulator::~Emulator() {
+    stop.store(true, std::memory_order_relaxed);
+    if (thread.joinable()) thread.join();
+}
+
+std::uint64_t Emulator::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Emulator::Send(Command command) { return commands.Push(command); }
+
+void Emulator::Join() {
+    if (thread.joinable()) thread.join();
+    if (error) std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+void Emulator::Loop() {
+    try {
+        Scheduler scheduler(c8, output);
+        while (!c8.quit && !stop.load(std::memory_order_relaxed)) {
+            for (Command command; commands.Pop(command); ) Apply(command);
+            try { scheduler.Frame(); }
+            catch (const std::runtime_error& trap) { // Stopped before the instruction
+                c8.paused = true;
+                fault = trap.what();
+                SaveTrace();
+            }
+            if (pending && c8.dirty_rows) responded = pending, pending = 0;
+            else if (pending && Now() - pending > PENDING_NS) pending = 0;
+            c8.dirty_rows = 0;
+            auto& frame = frames.Back();
+            c8.Capture(frame);
+            frame.fault[fault.copy(frame.fault.data(), frame.fault.size() - 1)] = '\0';
+            frame.responded = responded;
+            if (c8.breakpoints) frame.breakpoints = c8.breakpoints->Addresses();
+            frames.Publish();
+            scheduler.Wait();
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    running.store(false, std::memory_order_release);
+}
+
+void Emulator::Apply(const Command& command) {
+    switch (command.type) {
+        case Command::KEY:
+            if (c8.PressKey(command.key) && !pending) pending = command.time; // Latency from here
+            break;
+        case Command::PAUSE:      if (!(c8.paused ^= 1)) fault.clear();                    break;
+        case Command::STEP:       c8.step = true;                                          break;
+        case Command::RESET:      c8.Reset(), fault.clear();                               break;
+        case Command::SLOWER:     c8.cycle_speed -= c8.cycle_speed > 20.0f   ? 20.0f : 0.0f; break;
+        case Command::FASTER:     c8.cycle_speed += c8.cycle_speed < 9000.0f ? 20.0f : 0.0f; break;
+        case Command::UNTHROTTLE: c8.unthrottled ^= 1;                                     break;
+        case Command::REWIND:     c8.rewind++, c8.paused = true, fault.clear();            break;
+        case Command::SAVE:       SaveState();                                             break;
+        case Command::LOAD:       LoadState(), fault.clear();                              break;
+        case Command::TRACE:      SaveTrace();                                             break;
+        case Command::BREAK: // At PC, or none there
+            if (c8.breakpoints) c8.breakpoints->Toggle(c8.State().PC);
+            break;
+        case Command::WATCH: // Writes to what the instruction at PC accesses
+            if (c8.breakpoints) c8.breakpoints->ToggleWatch(c8.State(), c8.GetQuirks());
+            break;
+        case Command::QUIT:       c8.quit = true;                                          break;
+    }
+}
+
+// Save states go next to the ROM, as <rom>.state
+void Emulator::SaveState() {
+    std::vector<std::uint8_t> state;
+    c8.SaveState(state);
+    std::ofstream(c8.Rom().Filename() + ".state", std::ios::binary)
+        .write(reinterpret_cast<const char*>(state.data()), state.size());
+}
+
+void Emulator::LoadState() {
+    std::ifstream file(c8.Rom().Filename() + ".state", std::ios::binary);
+    if (!file.is_open()) return;
+    std::vector<std::uint8_t> state(Chip8::STATE_SIZE + 1);
+    state.resize(file.read(reinterpret_cast<char*>(state.data()), state.size()).gcount());
+    try { c8.LoadState(state); } catch (const std::runtime_error&) { } // Not ours, ignore
+}
+
+// Next to the ROM too, as <rom>.trace, with the fault that stopped the core
+void Emulator::SaveTrace() {
+    if (!c8.trace) return;
+    try { c8.trace->Save(c8.Rom().Filename() + ".trace", c8, fault); }
+    catch (const std::runtime_error&) { } // Nowhere to write, keep running
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include "FrameExport.hpp"
+#include "SpscQueue.hpp"
+#include "TripleBuffer.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <utility>
+#include <exception>
+
+// Runs the core and its Scheduler on a thread of their own. Once per frame
+// the machine is captured into a Snapshot and published through a triple
+// buffer; the front end reads the newest one whenever it gets to it and
+// sends input back as Commands over an SPSC queue. Nothing blocks across the
+// two threads, so however slow the terminal is the emulation keeps its pace.
+// A trap (stack overflow...) or a breakpoint pauses the core on the
+// instruction it stopped before, and writes out its execution trace if it
+// keeps one; resuming runs that instruction.
+// The first frame that changes the screen after a key press hands the
+// press time back in Snapshot::responded, so the front end can show the
+// input to display latency.
+class Emulator final {
+public:
+    struct Command {
+        enum Type : std::uint8_t {
+            KEY, PAUSE, STEP, RESET, SLOWER, FASTER, UNTHROTTLE, REWIND, SAVE, LOAD, TRACE,
+            BREAK, WATCH, QUIT
+        } type;
+        char          key  = 0; // KEY only
+        std::uint64_t time = 0; // KEY only: steady clock ns when it was read, for latency
+    };
+
+    explicit Emulator(Chip8& c8, FrameExport* output = nullptr); // Starts the emulation thread
+   ~Emulator();                   // Stops it
+
+    Emulator(const Emulator&) = delete;
+    Emulator& operator=(const Emulator&) = delete;
+
+    // Front end side
+    bool Send(Command command); // Dropped (false) when the queue is full
+    const Snapshot& Latest() { return frames.Front(); }
+    bool Running() const { return running.load(std::memory_order_acquire); }
+    void Join();                // Waits for the thread, rethrows what stopped it
+
+    const RomImage& Rom() const { return c8.Rom(); }
+
+    static std::uint64_t Now(); // Steady clock, ns: Command::time and Snapshot::responded
+
+private:
+    Chip8&       c8;
+    FrameExport* output; // Every emulated frame, on the emulation thread
+
+    TripleBuffer<Snapshot>  frames;
+    SpscQueue<Command, 256> commands;
+
+    std::atomic<bool>  running { true };
+    std::atomic<bool>  stop    { false };
+    std::exception_ptr error;
+    std::string        fault; // What stopped the core, until it resumes, resets, loads or rewinds
+    std::uint64_t      pending   = 0; // Time of the oldest press the screen has not answered
+    std::uint64_t      responded = 0;
+    std::thread        thread;
+
+    void Loop();
+    void Apply(const Command& command);
+    void SaveState();
+    void LoadState();
+    void SaveTrace();
+};
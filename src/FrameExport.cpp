@@ -0,0 +1,93 @@
+#include "FrameExport.hpp"
+
+#include <new>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+FrameExport::~FrameExport() {
+    if (shared) munmap(shared, sizeof(SharedFrames)), shm_unlink(name.c_str());
+    if (fd > STDERR_FILENO) close(fd);
+}
+
+void FrameExport::Share(const std::string& object) {
+    name = object[0] == '/' ? object : "/" + object;
+    int shm = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (shm < 0) throw std::runtime_error("chip8: Cannot create shared memory " + name);
+    void* map = ftruncate(shm, sizeof(SharedFrames)) == 0
+        ? mmap(nullptr, sizeof(SharedFrames), PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0)
+        : MAP_FAILED;
+    close(shm);
+    if (map == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("chip8: Cannot map shared memory " + name);
+    }
+    shared = new (map) SharedFrames; // `latest` stays 0 until the first frame is in
+}
+
+void FrameExport::Stream(const std::string& path, Format kind) {
+    fd = path == "-" ? STDOUT_FILENO : open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("chip8: Cannot open " + path);
+    std::signal(SIGPIPE, SIG_IGN); // A reader going away ends the stream, not the emulator
+
+    format = kind;
+    Layout(false);
+}
+
+void FrameExport::Layout(bool high) {
+    int width = high ? HIRES_WIDTH : SCREEN_WIDTH, height = high ? HIRES_HEIGHT : SCREEN_HEIGHT;
+    auto text = std::string(format == Format::PBM ? "P4\n" : "P5\n") + std::to_string(width) + " " +
+                std::to_string(height) + (format == Format::PBM ? "\n" : "\n255\n");
+    auto bytes = format == Format::PBM ? width/8 * height : width * height;
+    hires  = high;
+    header = text.size();
+    image.assign(text.begin(), text.end());
+    image.resize(header + bytes);
+}
+
+void FrameExport::Publish(const Chip8& c8) {
+    auto& state = c8.State();
+    frame++;
+
+    if (shared) {
+        auto& slot = shared->ring[frame % SharedFrames::SLOTS];
+        auto sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.frame  = frame,        slot.cycles = state.cycles;
+        slot.pixels = state.pixels, slot.V      = state.V;
+        slot.PC = state.PC, slot.I  = state.I;
+        slot.DT = state.DT, slot.ST = state.ST, slot.SP = state.SP;
+        slot.hires  = state.hires;
+        if (state.hires) slot.hires_pixels = state.hires_pixels;
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+        shared->latest.store(frame, std::memory_order_release);
+    }
+
+    if (fd < 0) return;
+    // PBM rows are packed most significant bit first, the same order as a
+    // pixel row; PGM spends a byte per pixel, 0 or 255
+    if (state.hires != hires) Layout(state.hires);
+    auto* out = image.data() + header;
+    auto put = [&](std::uint64_t word) {
+        if (format == Format::PBM)
+            for (int byte = 7; byte >= 0; byte--) *out++ = word >> (8*byte);
+        else
+            for (int col = 63; col >= 0; col--) *out++ = word >> col & 1 ? 255 : 0;
+    };
+    if (state.hires) for (auto& row: state.hires_pixels) put(row[0]), put(row[1]);
+    else             for (auto row: state.pixels) put(row);
+    for (std::size_t done = 0; done < image.size(); ) {
+        auto written = write(fd, image.data() + done, image.size() - done);
+        if (written > 0) { done += written; continue; }
+        if (written < 0 && errno == EINTR) continue;
+        if (fd > STDERR_FILENO) close(fd); // Reader gone (EPIPE) or disk full
+        fd = -1;
+        return;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Chip8.hpp"
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Layout of the shared memory object, for the processes that map it: the
+// header, then a ring of FRAME_SLOTS frames. Frame n goes to slot n % slots
+// and `latest` is the newest complete one. Each slot is a seqlock: its
+// sequence is odd while the emulator writes it, so a reader copies the
+// slot, checks that the sequence did not move and that the copy is the
+// frame it wanted, and otherwise retries or skips ahead. Nothing waits on
+// readers: one more than FRAME_SLOTS frames behind loses frames. A
+// SUPER-CHIP frame in 128x64 mode has `hires` set and its picture in
+// `hires_pixels` instead of `pixels`.
+struct alignas(64) SharedFrame {
+    std::atomic<std::uint64_t> sequence { 0 };
+    std::uint64_t frame  = 0; // Emulated 60Hz frames since start, from 1
+    std::uint64_t cycles = 0;
+    std::array<std::uint64_t, SCREEN_HEIGHT> pixels = { }; // Column c is bit 63-c
+    std::array<HiresRow, HIRES_HEIGHT> hires_pixels = { }; // Column c is bit 63-c%64 of word c/64
+    std::array<std::uint8_t, 16> V = { };
+    std::uint16_t PC = 0, I = 0;
+    std::uint8_t  DT = 0, ST = 0, SP = 0;
+    bool          hires = false;
+};
+
+struct SharedFrames {
+    static constexpr std::uint32_t MAGIC   = 0x52463843; // "C8FR"
+    static constexpr std::uint32_t VERSION = 2;
+    static constexpr std::uint32_t SLOTS   = 64;
+
+    std::uint32_t magic   = MAGIC;
+    std::uint32_t version = VERSION;
+    std::uint32_t slots   = SLOTS;
+    std::uint32_t size    = sizeof(SharedFrame); // Slot stride
+    std::uint32_t width   = SCREEN_WIDTH, height = SCREEN_HEIGHT; // Of `pixels`
+    alignas(64) std::atomic<std::uint64_t> latest { 0 }; // 0 until the first frame
+    std::array<SharedFrame, SLOTS> ring;
+
+    // Reader side, inline so that consumers need this header only: frame
+    // `wanted` into `out`, false if it is gone or was being written
+    bool Read(std::uint64_t wanted, SharedFrame& out) const {
+        auto& slot = ring[wanted % slots];
+        auto before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) return false;
+        out.frame  = slot.frame,  out.cycles = slot.cycles;
+        out.pixels = slot.pixels, out.V      = slot.V;
+        out.PC = slot.PC, out.I  = slot.I;
+        out.DT = slot.DT, out.ST = slot.ST, out.SP = slot.SP;
+        out.hires  = slot.hires;
+        if (out.hires) out.hires_pixels = slot.hires_pixels;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == before && out.frame == wanted;
+    }
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared across processes");
+
+// Where completed frames go besides the TUI: a POSIX shared memory ring
+// (Share) and/or a raw PBM or PGM stream (Stream), one image per frame,
+// for encoders and graders; a stream switches to 128x64 images while a
+// SUPER-CHIP ROM is in that mode. Publish() runs on the emulation thread after
+// every emulated frame, at whatever speed the core runs; the ring never
+// blocks it, a stream's reader paces it.
+class FrameExport final {
+public:
+    enum class Format : std::uint8_t { PBM, PGM };
+
+    FrameExport() = default;
+   ~FrameExport();
+
+    FrameExport(const FrameExport&) = delete;
+    FrameExport& operator=(const FrameExport&) = delete;
+
+    void Share(const std::string& name);                 // shm_open(name), unlinked on exit
+    void Stream(const std::string& path, Format format); // "-" for stdout
+
+    bool Enabled() const { return shared || fd >= 0; }
+    void Publish(const Chip8& c8);
+
+private:
+    std::string   name;
+    SharedFrames* shared = nullptr;
+    int           fd     = -1;
+    Format        format = Format::PBM;
+    bool          hires  = false;      // Size `image` is laid out for
+    std::size_t   header = 0;          // Bytes of `image` before the pixels
+    std::vector<std::uint8_t> image;   // One whole frame, sent with one write()
+    std::uint64_t frame  = 0;
+
+    void Layout(bool high);            // Header and size of `image`
+};
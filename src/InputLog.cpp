@@ -0,0 +1,119 @@
+#include "InputLog.hpp"
+#include "Chip8.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+constexpr std::uint8_t LOG_VERSION = 3;
+
+void InputLog::Record(std::uint64_t cycle, Type type, std::uint64_t value) {
+    events.push_back({cycle, type, value});
+    ticks += type == Type::TIMER;
+}
+
+void InputLog::Truncate(std::size_t length) {
+    if (length >= events.size()) return;
+    for (auto it = events.begin() + length; it != events.end(); ++it)
+        ticks -= it->type == Type::TIMER;
+    events.resize(length);
+}
+
+// Little endian like the save states: "C8IN", version, ROM hash, seed, key
+// hold, quirks, event count, then per event its type, a varint cycle delta
+// and its payload (1 byte for KEY and RELEASE, 8 for HASH, none otherwise).
+// Version 1 predates key releases and holds, its sessions do not replay;
+// version 2 has no quirks byte and ran with the default ones.
+void InputLog::Save(const std::string& filename) const {
+    std::vector<std::uint8_t> out { 'C', '8', 'I', 'N', LOG_VERSION };
+    auto put = [&out](std::uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) out.push_back(value >> (8*i) & 0xff);
+    };
+    auto put_varint = [&out](std::uint64_t value) {
+        for (; value >= 0x80; value >>= 7) out.push_back(value | 0x80);
+        out.push_back(value);
+    };
+
+    put(rom_hash, 8); put(seed, 8); put(hold, 1); put(quirks, 1); put(events.size(), 8);
+    std::uint64_t cycle = 0;
+    for (auto& event: events) {
+        put(static_cast<std::uint8_t>(event.type), 1);
+        put_varint(event.cycle - cycle); cycle = event.cycle;
+        if      (event.type == Type::KEY || event.type == Type::RELEASE) put(event.value, 1);
+        else if (event.type == Type::HASH) put(event.value, 8);
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(out.data()), out.size()))
+        throw std::runtime_error("chip8: Cannot write input log " + filename);
+}
+
+InputLog InputLog::Load(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("chip8: Cannot open input log " + filename);
+    std::vector<std::uint8_t> in(std::istreambuf_iterator<char>(file), { });
+
+    auto it = in.cbegin();
+    auto need = [&](std::size_t bytes) {
+        if (static_cast<std::size_t>(in.cend() - it) < bytes)
+            throw std::runtime_error("chip8: Truncated input log " + filename);
+    };
+    auto get = [&](int bytes) {
+        need(bytes);
+        std::uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) value |= std::uint64_t(*it++) << (8*i);
+        return value;
+    };
+    auto get_varint = [&]() {
+        std::uint64_t value = 0;
+        for (int shift = 0; ; shift += 7) {
+            auto byte = get(1);
+            value |= (byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+    };
+
+    need(5);
+    if (std::string(it, it+4) != "C8IN") throw std::runtime_error("chip8: Not an input log " + filename);
+    auto version = it[4];
+    if (version != LOG_VERSION && version != 2) throw std::runtime_error("chip8: Unsupported input log version");
+    it += 5;
+
+    InputLog log;
+    log.rom_hash = get(8);
+    log.seed     = get(8);
+    log.hold     = get(1);
+    log.quirks   = version >= 3 ? get(1) : Quirks::DEFAULT;
+    if (log.quirks >= Quirks::COUNT) throw std::runtime_error("chip8: Corrupted input log " + filename);
+    auto count   = get(8);
+    std::uint64_t cycle = 0;
+    for (std::uint64_t i = 0; i < count; i++) {
+        auto type = static_cast<Type>(get(1));
+        if (type > Type::RELEASE) throw std::runtime_error("chip8: Corrupted input log " + filename);
+        cycle += get_varint();
+        bool key = type == Type::KEY || type == Type::RELEASE;
+        std::uint64_t value = key ? get(1) : type == Type::HASH ? get(8) : 0;
+        log.Record(cycle, type, value);
+    }
+    return log;
+}
+
+bool InputLog::Replay(Chip8& c8, const std::function<void(const Event&)>& applied) const {
+    c8.Seed(seed);
+    c8.SetKeyHold(hold);
+    c8.SetQuirks(quirks);
+    for (auto& event: events) {
+        c8.Run(event.cycle - c8.cycles);
+        bool match = true;
+        switch (event.type) {
+            case Type::KEY:     c8.PressKey(static_cast<char>(event.value));   break;
+            case Type::RELEASE: c8.ReleaseKey(static_cast<char>(event.value)); break;
+            case Type::TIMER:   c8.UpdateTimers();                             break;
+            case Type::RESET:   c8.Reset();                                    break;
+            case Type::HASH:    match = c8.FrameHash() == event.value;         break;
+        }
+        if (applied) applied(event);
+        if (!match) return false;
+    }
+    return true;
+}
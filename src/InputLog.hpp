@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Keyboard.hpp"
+#include "Quirks.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+class Chip8;
+
+// Everything that reaches a Chip8 from outside (key presses and releases,
+// 60Hz timer ticks, resets), stamped with the instruction count it arrived at. Replayed
+// on the same ROM and seed it reproduces the session bit for bit; HASH events
+// carry the framebuffer hash every HASH_INTERVAL ticks to prove it.
+class InputLog final {
+public:
+    enum class Type : std::uint8_t { KEY, TIMER, RESET, HASH, RELEASE };
+
+    struct Event {
+        std::uint64_t cycle = 0;
+        Type          type  = Type::TIMER;
+        std::uint64_t value = 0; // Key character, or framebuffer hash
+    };
+
+    static constexpr std::uint64_t HASH_INTERVAL = 60;
+
+    std::uint64_t      rom_hash = 0;
+    std::uint64_t      seed     = 0;
+    std::uint8_t       hold     = Keyboard::HOLD; // Chip8::SetKeyHold() of the session
+    std::uint8_t       quirks   = Quirks::DEFAULT; // Chip8::SetQuirks() of the session
+    std::vector<Event> events;
+    std::uint64_t      ticks    = 0; // TIMER events so far
+
+    void Record(std::uint64_t cycle, Type type, std::uint64_t value = 0);
+    void Truncate(std::size_t length); // Forget the events after the first `length`
+
+    void Save(const std::string& filename) const;
+    static InputLog Load(const std::string& filename);
+
+    // Runs `c8` (fresh, seeded with `seed`, keys held for `hold`, `quirks` set)
+    // through every event, calling `applied` after each one. Returns false on
+    // the first HASH mismatch.
+    bool Replay(Chip8& c8, const std::function<void(const Event&)>& applied = { }) const;
+};
@@ -0,0 +1,359 @@
+#include "Jit.hpp"
+#include "Chip8.hpp"
+
+#include <utility>
+#include <stdexcept>
+#include <sys/mman.h>
+
+#if defined(__x86_64__)
+
+namespace {
+    constexpr std::size_t  BUFFER_SIZE = 4 << 20;
+    constexpr std::size_t  MAX_BLOCK   = 32;                 // Instructions, fits the imm8 budget check
+    constexpr std::size_t  MAX_NATIVE  = MAX_BLOCK*64 + 256; // Worst case bytes for one block
+    constexpr std::uint8_t EAX = 0, ECX = 1, EDX = 2;
+
+    constexpr bool Terminates(Opcode op) {
+        switch (op) {
+            case Opcode::JP:       case Opcode::CALL:      case Opcode::RET:
+            case Opcode::JP_V0:    case Opcode::SE_VX_NN:  case Opcode::SNE_VX_NN:
+            case Opcode::SE_VX_VY: case Opcode::SNE_VX_VY: case Opcode::SKP:
+            case Opcode::SKNP:     case Opcode::LD_VX_K:   case Opcode::LD_B_VX:
+            case Opcode::LD_MEM_VX:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+Jit::Jit(Chip8& c8): c8(c8) {
+    void* map = mmap(nullptr, BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) throw std::runtime_error("chip8: Cannot map the JIT buffer");
+    buffer = cursor = static_cast<std::uint8_t*>(map);
+    writable = true;
+
+    auto base = reinterpret_cast<const std::uint8_t*>(&c8);
+    auto at   = [base](const void* field) {
+        return static_cast<std::int32_t>(static_cast<const std::uint8_t*>(field) - base);
+    };
+    oV  = at(c8.V.data()); oPC = at(&c8.PC); oI  = at(&c8.I);
+    oOP = at(&c8.OP);      oDT = at(&c8.DT); oST = at(&c8.ST);
+    oKeys = at(c8.hexpad.keys.data());
+
+    // enter(base, budget, block): rbx = base, r12 = budget, r13 = table
+    enter = reinterpret_cast<Entry>(cursor);
+    Byte(0x53); Byte(0x41); Byte(0x54); Byte(0x41); Byte(0x55); // push rbx, r12, r13
+    Byte(0x48); Byte(0x89); Byte(0xfb);                         // mov rbx, rdi
+    Byte(0x49); Byte(0x89); Byte(0xf4);                         // mov r12, rsi
+    Byte(0x49); Byte(0xbd); Qword(reinterpret_cast<std::uint64_t>(table.data())); // mov r13, imm64
+    Byte(0xff); Byte(0xe2);                                     // jmp rdx
+
+    exit = cursor;
+    Byte(0x4c); Byte(0x89); Byte(0xe0);                         // mov rax, r12
+    Byte(0x41); Byte(0x5d); Byte(0x41); Byte(0x5c); Byte(0x5b); // pop r13, r12, rbx
+    Byte(0xc3);                                                 // ret
+
+    blocks = cursor;
+    Flush();
+    Writable(false);
+}
+
+Jit::~Jit() { munmap(buffer, BUFFER_SIZE); }
+
+void Jit::Run(std::uint64_t count) {
+    auto remaining = count;
+    while (remaining) {
+        if (stale) Flush();
+        auto PC = c8.PC;
+        if (PC > 0xfff) { c8.Interpret(1); remaining--; continue; } // Wrapped, leave it to the interpreter
+        if (table[PC] == exit) Compile(PC);
+        if (lengths[PC] > remaining) return c8.Interpret(remaining);
+
+        Writable(false);
+        auto left = enter(&c8, remaining, table[PC]);
+        c8.cycles += remaining - left;
+        remaining  = left;
+        if (pending) { // The block was charged in full on entry
+            c8.cycles -= unused;
+            std::rethrow_exception(std::exchange(pending, nullptr));
+        }
+    }
+}
+
+void Jit::Invalidate(std::uint16_t address, std::size_t length) {
+    for (std::size_t a = address; a < address + length; a++)
+        stale |= covered[a & 0xfff];
+    if (stale) table.fill(exit);
+}
+
+// W^X: the buffer is writable while Compile() emits and executable while
+// blocks run, never both; a burst of compiles switches it once
+void Jit::Writable(bool enable) {
+    if (writable == enable) return;
+    if (mprotect(buffer, BUFFER_SIZE, PROT_READ | (enable ? PROT_WRITE : PROT_EXEC)) != 0)
+        throw std::runtime_error("chip8: Cannot protect the JIT buffer");
+    writable = enable;
+}
+
+void Jit::Flush() {
+    cursor = blocks;
+    table.fill(exit);
+    lengths.fill(0);
+    covered.fill(false);
+    stale = false;
+}
+
+void Jit::Word(std::uint16_t value)  { for (int i = 0; i < 2; i++) Byte(value >> 8*i); }
+void Jit::Dword(std::uint32_t value) { for (int i = 0; i < 4; i++) Byte(value >> 8*i); }
+void Jit::Qword(std::uint64_t value) { for (int i = 0; i < 8; i++) Byte(value >> 8*i); }
+
+// ModRM for [rbx + disp32]
+void Jit::Mem(std::uint8_t reg, std::int32_t offset) { Byte(0x83 | reg << 3); Dword(offset); }
+
+void Jit::Rel32(const std::uint8_t* target) { Dword(static_cast<std::int32_t>(target - (cursor + 4))); }
+
+void Jit::LoadV(std::uint8_t reg, int x)  { Byte(0x0f); Byte(0xb6); Mem(reg, oV + x); } // movzx r32, byte
+void Jit::StoreV(int x, std::uint8_t reg) { Byte(0x88); Mem(reg, oV + x); }             // mov byte, r8
+
+// helper(this, OP), then leave through the exit stub if it threw. The upper
+// half of the OP immediate is patched once the block length is known with
+// the instructions a throw would leave unrun, this one included.
+void Jit::Helper(bool (*helper)(Jit*, std::uint32_t), std::uint16_t OP) {
+    Byte(0x48); Byte(0xbf); Qword(reinterpret_cast<std::uint64_t>(this));   // mov rdi, imm64
+    Byte(0xbe); calls.emplace_back(cursor, length - 1); Dword(OP);          // mov esi, imm32
+    Byte(0x48); Byte(0xb8); Qword(reinterpret_cast<std::uint64_t>(helper)); // mov rax, imm64
+    Byte(0xff); Byte(0xd0);                                                 // call rax
+    Byte(0x84); Byte(0xc0);                                                 // test al, al
+    Byte(0x0f); Byte(0x85); Rel32(exit);                                    // jnz exit
+}
+
+void Jit::ExitTo(std::uint16_t target, std::uint16_t OP) {
+    Byte(0x66); Byte(0xc7); Mem(0, oPC); Word(target);                      // mov word [PC], imm16
+    Byte(0x66); Byte(0xc7); Mem(0, oOP); Word(OP);                          // mov word [OP], imm16
+    if (target > 0xfff) { Byte(0xe9); Rel32(exit); return; }                // jmp exit
+    Byte(0x49); Byte(0x8b); Byte(0x85); Dword(target * 8);                  // mov rax, [r13 + target*8]
+    Byte(0xff); Byte(0xe0);                                                 // jmp rax
+}
+
+void Jit::ExitToEax(std::uint16_t OP, bool store_pc) {
+    if (store_pc) { Byte(0x66); Byte(0x89); Mem(EAX, oPC); }                // mov word [PC], ax
+    else          { Byte(0x0f); Byte(0xb7); Mem(EAX, oPC); }                // movzx eax, word [PC]
+    Byte(0x66); Byte(0xc7); Mem(0, oOP); Word(OP);                          // mov word [OP], imm16
+    Byte(0x3d); Dword(0xfff);                                               // cmp eax, 0xfff
+    Byte(0x0f); Byte(0x87); Rel32(exit);                                    // ja exit
+    Byte(0x49); Byte(0x8b); Byte(0x44); Byte(0xc5); Byte(0x00);             // mov rax, [r13 + rax*8]
+    Byte(0xff); Byte(0xe0);                                                 // jmp rax
+}
+
+template <void (Chip8::*handler)(const Instruction&)>
+bool Jit::Call(Jit* jit, std::uint32_t OP) {
+    Instruction in;
+    in.OP = OP & 0xffff; in.NNN = NNN(OP); in.NN = NN(OP); in.N = N(OP); in.X = X(OP); in.Y = Y(OP);
+    try { (jit->c8.*handler)(in); return false; }
+    catch (...) {
+        jit->pending = std::current_exception();
+        jit->unused  = OP >> 16;
+        jit->c8.OP   = in.OP;
+        return true;
+    }
+}
+
+// The helpers whose handler depends on the quirks
+#define QUIRKED(handler) Quirked(c8.quirks, [](auto q) { return &Call<&Chip8::handler<decltype(q)::value>>; }, \
+                                 std::make_index_sequence<Quirks::COUNT>())
+
+void Jit::Compile(std::uint16_t address) {
+    if (static_cast<std::size_t>(buffer + BUFFER_SIZE - cursor) < MAX_NATIVE) Flush();
+    Writable(true);
+
+    table[address] = cursor;
+
+    // Budget check, patched with the length once the block is decoded
+    Byte(0x49); Byte(0x83); Byte(0xfc); auto check = cursor; Byte(0); // cmp r12, imm8
+    Byte(0x0f); Byte(0x82); Rel32(exit);                              // jb exit
+    Byte(0x49); Byte(0x83); Byte(0xec); auto take  = cursor; Byte(0); // sub r12, imm8
+
+    length = 0;
+    calls.clear();
+    // Quirks are settled here, SetQuirks() flushes the blocks
+    bool shift_vy = c8.quirks & Quirks::SHIFT_VY, jump_vx = c8.quirks & Quirks::JUMP_VX;
+    bool schip    = c8.quirks & Quirks::SCHIP;
+    auto PC = address;
+    for (;;) {
+        std::uint16_t OP = c8.memory[PC & 0xfff] << 8 | c8.memory[(PC+1) & 0xfff];
+        auto op   = Decode(OP);
+        int  x    = X(OP), y = Y(OP);
+        auto next = static_cast<std::uint16_t>(PC + 2);
+        covered[PC & 0xfff] = covered[(PC+1) & 0xfff] = true;
+        length++;
+
+        // Flag results are written to VF first, then VX is computed again from
+        // the registers when either operand is VF, exactly like the handlers.
+        auto reload = [&]() { if (x == 0xf || y == 0xf) LoadV(EAX, x), LoadV(ECX, y); };
+
+        switch (op) {
+            case Opcode::SYS: case Opcode::UNKNOWN: break;
+            case Opcode::CLS: Helper(QUIRKED(op_00e0), OP); break;
+            case Opcode::RET:
+                Byte(0x66); Byte(0xc7); Mem(0, oPC); Word(next);
+                Helper(&Call<&Chip8::op_00ee>, OP);
+                ExitToEax(OP, false);
+                break;
+            case Opcode::JP:   ExitTo(NNN(OP), OP); break;
+            case Opcode::CALL:
+                Byte(0x66); Byte(0xc7); Mem(0, oPC); Word(next);
+                Helper(&Call<&Chip8::op_2nnn>, OP);
+                ExitTo(NNN(OP), OP);
+                break;
+            case Opcode::SE_VX_NN: case Opcode::SNE_VX_NN:
+                Byte(0x80); Mem(7, oV + x); Byte(NN(OP));                  // cmp byte [VX], imm8
+                goto skip;
+            case Opcode::SE_VX_VY: case Opcode::SNE_VX_VY:
+                LoadV(EDX, x); Byte(0x3a); Mem(EDX, oV + y);               // cmp dl, [VY]
+            skip:
+                Byte(0xb8); Dword(next);                                   // mov eax, next
+                Byte(0xb9); Dword(next + 2);                               // mov ecx, next+2
+                Byte(0x0f); Byte(op == Opcode::SE_VX_NN || op == Opcode::SE_VX_VY ? 0x44 : 0x45);
+                Byte(0xc1);                                                // cmove/cmovne eax, ecx
+                ExitToEax(OP, true);
+                break;
+            case Opcode::LD_VX_NN: Byte(0xc6); Mem(0, oV + x); Byte(NN(OP)); break; // mov byte [VX], imm8
+            case Opcode::ADD_VX_NN: Byte(0x80); Mem(0, oV + x); Byte(NN(OP)); break; // add byte [VX], imm8
+            case Opcode::LD_VX_VY: LoadV(EAX, y); StoreV(x, EAX); break;
+            case Opcode::OR: case Opcode::AND: case Opcode::XOR:
+                LoadV(EAX, x); LoadV(ECX, y);
+                Byte(op == Opcode::OR ? 0x09 : op == Opcode::AND ? 0x21 : 0x31); Byte(0xc8); // op eax, ecx
+                StoreV(x, EAX);
+                break;
+            case Opcode::ADD_VX_VY:
+                LoadV(EAX, x); LoadV(ECX, y);
+                Byte(0x01); Byte(0xc8);                                    // add eax, ecx
+                Byte(0x3d); Dword(0xff);                                   // cmp eax, 0xff
+                Byte(0x0f); Byte(0x97); Byte(0xc2); StoreV(0xf, EDX);      // seta dl
+                if (x == 0xf || y == 0xf) { reload(); Byte(0x01); Byte(0xc8); }
+                StoreV(x, EAX);
+                break;
+            case Opcode::SUB:
+                LoadV(EAX, x); LoadV(ECX, y);
+                Byte(0x39); Byte(0xc8);                                    // cmp eax, ecx
+                Byte(0x0f); Byte(0x97); Byte(0xc2); StoreV(0xf, EDX);      // seta dl
+                reload();
+                Byte(0x29); Byte(0xc8);                                    // sub eax, ecx
+                StoreV(x, EAX);
+                break;
+            case Opcode::SUBN:
+                LoadV(EAX, x); LoadV(ECX, y);
+                Byte(0x39); Byte(0xc1);                                    // cmp ecx, eax
+                Byte(0x0f); Byte(0x97); Byte(0xc2); StoreV(0xf, EDX);      // seta dl
+                reload();
+                Byte(0x29); Byte(0xc1);                                    // sub ecx, eax
+                StoreV(x, ECX);
+                break;
+            case Opcode::SHR: {
+                int source = shift_vy ? y : x;
+                LoadV(EAX, source);
+                Byte(0x89); Byte(0xc2); Byte(0x83); Byte(0xe2); Byte(0x01); // mov edx, eax; and edx, 1
+                StoreV(0xf, EDX);
+                if (source == 0xf) LoadV(EAX, source);
+                Byte(0xd1); Byte(0xe8);                                    // shr eax, 1
+                StoreV(x, EAX);
+                break;
+            }
+            case Opcode::SHL: {
+                int source = shift_vy ? y : x;
+                LoadV(EAX, source);
+                Byte(0x89); Byte(0xc2); Byte(0xc1); Byte(0xea); Byte(0x07); // mov edx, eax; shr edx, 7
+                StoreV(0xf, EDX);
+                if (source == 0xf) LoadV(EAX, source);
+                Byte(0x01); Byte(0xc0);                                    // add eax, eax
+                StoreV(x, EAX);
+                break;
+            }
+            case Opcode::LD_I: Byte(0x66); Byte(0xc7); Mem(0, oI); Word(NNN(OP)); break; // mov word [I], imm16
+            case Opcode::JP_V0:
+                LoadV(EAX, jump_vx ? x : 0); Byte(0x05); Dword(NNN(OP));   // add eax, imm32
+                ExitToEax(OP, true);
+                break;
+            case Opcode::RND: Helper(&Call<&Chip8::op_cxnn>, OP); break;
+            case Opcode::DRW: Helper(QUIRKED(op_dxyn), OP); break;
+            case Opcode::SKP: case Opcode::SKNP: {
+                // Key states only change between blocks, a skip is a plain test
+                bool skp = op == Opcode::SKP;
+                LoadV(EAX, x);
+                Byte(0x31); Byte(0xc9);                                    // xor ecx, ecx
+                Byte(0x83); Byte(0xf8); Byte(0x0f);                        // cmp eax, 15
+                Byte(0x77); Byte(11);                                      // ja +11 (up)
+                Byte(0xf6); Byte(0x84); Byte(0x03); Dword(oKeys); Byte(Keyboard::HELD); // test byte [rbx+rax+keys], HELD
+                Byte(0x0f); Byte(0x95); Byte(0xc1);                        // setnz cl
+                Byte(0xb8); Dword(skp ? next : next + 2);                  // mov eax, next PC if up
+                Byte(0xba); Dword(skp ? next + 2 : next);                  // mov edx, next PC if down
+                Byte(0x85); Byte(0xc9);                                    // test ecx, ecx
+                Byte(0x0f); Byte(0x45); Byte(0xc2);                        // cmovnz eax, edx
+                ExitToEax(OP, true);
+                break;
+            }
+            case Opcode::LD_VX_K: {
+                // Waiting, nothing latched, is decided here; taking a key
+                // goes through the handler
+                Byte(0x48); Byte(0x8b); Mem(EAX, oKeys);                   // mov rax, [keys]
+                Byte(0x48); Byte(0x0b); Mem(EAX, oKeys + 8);               // or rax, [keys+8]
+                Byte(0x48); Byte(0xb9); Qword(0x0101010101010101ull * Keyboard::LATCH); // mov rcx, latches
+                Byte(0x48); Byte(0x85); Byte(0xc8);                        // test rax, rcx
+                Byte(0x0f); Byte(0x85); auto slow = cursor; Dword(0);      // jnz slow
+                Byte(0xb8); Dword(PC);                                     // mov eax, PC (wait)
+                ExitToEax(OP, true);
+
+                auto at = cursor; cursor = slow; Rel32(at); cursor = at;
+                Byte(0x66); Byte(0xc7); Mem(0, oPC); Word(next);
+                Helper(&Call<&Chip8::op_fx0a>, OP);
+                ExitToEax(OP, false);
+                break;
+            }
+            case Opcode::LD_VX_DT: Byte(0x0f); Byte(0xb6); Mem(EAX, oDT); StoreV(x, EAX); break;
+            case Opcode::LD_DT_VX: LoadV(EAX, x); Byte(0x88); Mem(EAX, oDT); break;
+            case Opcode::LD_ST_VX: LoadV(EAX, x); Byte(0x88); Mem(EAX, oST); break;
+            case Opcode::ADD_I_VX: LoadV(EAX, x); Byte(0x66); Byte(0x01); Mem(EAX, oI); break; // add word [I], ax
+            case Opcode::LD_F_VX:
+                LoadV(EAX, x);
+                Byte(0x8d); Byte(0x44); Byte(0x80); Byte(FONT_ADDRESS);    // lea eax, [rax + rax*4 + FONT]
+                Byte(0x66); Byte(0x89); Mem(EAX, oI);                      // mov word [I], ax
+                break;
+            case Opcode::LD_B_VX:   Helper(&Call<&Chip8::op_fx33>, OP); ExitTo(next, OP); break;
+            case Opcode::LD_MEM_VX: Helper(QUIRKED(op_fx55), OP); ExitTo(next, OP); break;
+            case Opcode::LD_VX_MEM: Helper(QUIRKED(op_fx65), OP); break;
+            // SUPER-CHIP, nothing at all without it
+            case Opcode::SCD:      if (schip) Helper(QUIRKED(op_00cn), OP); break;
+            case Opcode::SCR:      if (schip) Helper(QUIRKED(op_00fb), OP); break;
+            case Opcode::SCL:      if (schip) Helper(QUIRKED(op_00fc), OP); break;
+            case Opcode::LOW:      if (schip) Helper(QUIRKED(op_00fe), OP); break;
+            case Opcode::HIGH:     if (schip) Helper(QUIRKED(op_00ff), OP); break;
+            case Opcode::LD_HF_VX: if (schip) Helper(QUIRKED(op_fx30), OP); break;
+            case Opcode::LD_R_VX:  if (schip) Helper(QUIRKED(op_fx75), OP); break;
+            case Opcode::LD_VX_R:  if (schip) Helper(QUIRKED(op_fx85), OP); break;
+            case Opcode::EXIT:     if (schip) ExitTo(PC, OP); break;  // Spins on itself
+            case Opcode::COUNT: break;
+        }
+
+        if (Terminates(op) || (op == Opcode::EXIT && schip)) break;
+        if (length == MAX_BLOCK || next > 0xfff) { ExitTo(next, OP); break; }
+        PC = next;
+    }
+
+    *check = *take = static_cast<std::uint8_t>(length);
+    lengths[address] = length;
+    for (auto [imm, index]: calls) imm[2] = length - index, imm[3] = 0;
+}
+
+#undef QUIRKED
+
+#else // Not x86-64: Chip8::EnableJit() refuses before any of this is reached
+
+Jit::Jit(Chip8& c8): c8(c8) { throw std::runtime_error("chip8: The JIT needs an x86-64 host"); }
+Jit::~Jit() { }
+void Jit::Run(std::uint64_t) { }
+void Jit::Invalidate(std::uint16_t, std::size_t) { }
+void Jit::Flush() { }
+void Jit::Writable(bool) { }
+
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+
+class Chip8;
+struct Instruction;
+
+// x86-64 dynamic recompiler. Basic blocks (ending at jp, call, ret, jp v0,
+// skips, Fx0A and the stores Fx33/Fx55) are translated on first use into an
+// mmap'd buffer and chained through a per-address entry table. The buffer
+// is never writable and executable at once: mprotect() flips it between
+// compiling and running, for hosts that refuse W+X mappings.
+// The Chip8 registers stay in the Chip8 object; anything beyond plain
+// register arithmetic calls back into the interpreter's own handlers.
+//
+// Every block checks the remaining instruction budget on entry and returns
+// to C++ when it would overrun it, the interpreter then runs the tail, so
+// Run(count) executes exactly `count` instructions like Chip8::Interpret().
+class Jit final {
+public:
+#if defined(__x86_64__)
+    static constexpr bool SUPPORTED = true;
+#else
+    static constexpr bool SUPPORTED = false;
+#endif
+
+    explicit Jit(Chip8& c8);
+    ~Jit();
+
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    void Run(std::uint64_t count);
+
+    // Stores into compiled code: the blocks stop being entered right away
+    // and the buffer is dropped once control is back in Run()
+    void Invalidate(std::uint16_t address, std::size_t length);
+    void Flush();
+
+private:
+    using Entry = std::uint64_t (*)(void* base, std::uint64_t budget, const void* block);
+
+    Chip8&              c8;
+    std::uint8_t*       buffer = nullptr; // Trampoline, exit stub, then blocks
+    std::uint8_t*       blocks = nullptr;
+    std::uint8_t*       cursor = nullptr; // Next free byte
+    Entry               enter  = nullptr;
+    const std::uint8_t* exit   = nullptr; // Returns the remaining budget to C++
+    bool                stale  = false;
+    bool                writable = false; // Else executable
+    std::exception_ptr  pending;          // Thrown by a handler inside native code
+    std::size_t         unused = 0;       // Instructions of its block the throw left unrun
+
+    // The block being compiled: instructions so far, and its helper calls as
+    // the address of their OP immediate and the instruction they stand for
+    std::size_t length = 0;
+    std::vector<std::pair<std::uint8_t*, std::size_t>> calls;
+
+    std::array<const void*,   4096> table   = { }; // Native block per PC, `exit` if none
+    std::array<std::uint8_t,  4096> lengths = { }; // Instructions per block
+    std::array<bool,          4096> covered = { }; // Bytes decoded into some block
+
+    std::int32_t oV = 0, oPC = 0, oI = 0, oOP = 0, oDT = 0, oST = 0, oKeys = 0; // Offsets into Chip8
+
+    void Compile(std::uint16_t address);
+    void Writable(bool enable);
+
+    // Emitter, all memory operands are [rbx + disp32] with rbx = &c8
+    void Byte(std::uint8_t byte) { *cursor++ = byte; }
+    void Word(std::uint16_t value);
+    void Dword(std::uint32_t value);
+    void Qword(std::uint64_t value);
+    void Mem(std::uint8_t reg, std::int32_t offset);
+    void Rel32(const std::uint8_t* target);
+    void LoadV(std::uint8_t reg, int x);
+    void StoreV(int x, std::uint8_t reg);
+    void Helper(bool (*helper)(Jit*, std::uint32_t), std::uint16_t OP);
+    void ExitTo(std::uint16_t target, std::uint16_t OP); // Constant next PC
+    void ExitToEax(std::uint16_t OP, bool store_pc);     // Next PC in eax
+
+    template <void (Chip8::*handler)(const Instruction&)>
+    static bool Call(Jit* jit, std::uint32_t OP);
+
+    // Call<> of the handler instantiated for `quirks`: pick(integral_constant<Q>)
+    // names it, one table per call site
+    template <typename Pick, std::size_t... Q>
+    static auto Quirked(std::uint8_t quirks, Pick pick, std::index_sequence<Q...>) {
+        static const std::array table { pick(std::integral_constant<std::uint8_t, Q>())... };
+        return table[quirks];
+    }
+};
@@ -2,32 +2,68 @@
 
 #include <array>
 #include <cstdint>
-#include <unordered_map>
 
+// Hexpad state, one byte per key: the low bits count the timer ticks the key
+// stays down for (HELD: until released), the top bit latches a press for
+// Fx0A until it takes it or the key goes up. Terminals only report presses,
+// auto-repeat keeps a held key down; front ends with key-up events release
+// keys themselves and press them with a hold of HELD.
 struct Keyboard {
 public:
-    std::array<bool, 16> keys = { };
+    static constexpr std::uint8_t LATCH = 0x80;
+    static constexpr std::uint8_t HELD  = 0x7f;
+    static constexpr std::uint8_t HOLD  = 10;   // Default, in 60Hz ticks
 
-    inline void Reset() { keys.fill(false); }
-    inline bool GetKey(int idx) const { return keys[idx]; }
+    std::array<std::uint8_t, 16> keys = { };
+    std::uint8_t                 hold = HOLD;  // Given to each press
 
-    void SetKey(char key) {
-        auto res = KeyMap.find(key);
-        if (res != KeyMap.end())
-            Reset(), keys[res->second] = true;
+    // Keyboard character -> hexpad key, -1 if unmapped
+    static constexpr int Map(char key) { return KeyMap[static_cast<std::uint8_t>(key)]; }
+
+    static constexpr bool IsDown(std::uint8_t state) { return state & HELD; }
+
+    // A press latches only if the key was up, repeats just extend the hold
+    static constexpr std::uint8_t Pressed(std::uint8_t state, std::uint8_t hold) {
+        return (IsDown(state) ? state & LATCH : LATCH) | hold;
     }
 
-    bool GetKeyFromMap(char key) const {
-        auto res = KeyMap.find(key);
-        return (res != KeyMap.end() ? keys[res->second] : false);
+    // One timer tick, branch-free so that Lockstep can run it over lanes
+    static constexpr std::uint8_t Decayed(std::uint8_t state) {
+        std::uint8_t ticks = state & HELD;
+        return (ticks == 0 || ticks == HELD) ? state : ticks == 1 ? 0 : state - 1;
+    }
+
+    inline bool Down(int key) const { return key < 16 && IsDown(keys[key]); }
+
+    bool Press(char key) {
+        int idx = Map(key);
+        if (idx < 0) return false;
+        keys[idx] = Pressed(keys[idx], hold);
+        return true;
     }
 
+    bool Release(char key) {
+        int idx = Map(key);
+        if (idx < 0) return false;
+        keys[idx] = 0;
+        return true;
+    }
+
+    inline void Decay() { for (auto& key: keys) key = Decayed(key); }
+
+    // Lowest latched key, its latch taken, or -1
+    int Take() {
+        for (int key = 0; key < 16; key++)
+            if (keys[key] & LATCH) return keys[key] &= ~LATCH, key;
+        return -1;
+    }
 
 private:
-    const std::unordered_map<int, std::uint8_t> KeyMap {
-        {'1', 0x1}, {'2', 0x2}, {'3', 0x3}, {'4', 0xc},
-        {'q', 0x4}, {'w', 0x5}, {'e', 0x6}, {'r', 0xd},
-        {'a', 0x7}, {'s', 0x8}, {'d', 0x9}, {'f', 0xe},
-        {'z', 0xa}, {'x', 0x0}, {'c', 0xb}, {'v', 0xf}
-    };
+    static constexpr std::array<std::int8_t, 256> KeyMap = []() {
+        std::array<std::int8_t, 256> map = { };
+        for (auto& key: map) key = -1;
+        const char layout[] = "x123qweasdzc4rfv"; // Terminal key of hexpad keys 0 to f
+        for (int key = 0; key < 16; key++) map[static_cast<std::uint8_t>(layout[key])] = key;
+        return map;
+    }();
 };
@@ -0,0 +1,371 @@
+#include "Lockstep.hpp"
+
+constexpr std::uint32_t NO_LANE = 0x10000; // Above any PC
+
+Lockstep::Lockstep(std::shared_ptr<const RomImage> rom, std::size_t lanes)
+: rom(std::move(rom)), size(lanes) {
+    std::copy(fontset.begin(), fontset.end(), image.begin() + FONT_ADDRESS);
+    std::copy(bigfontset.begin(), bigfontset.end(), image.begin() + BIG_FONT_ADDRESS);
+    std::copy_n(this->rom->Data(), this->rom->Size(), image.begin() + ENTRY_POINT);
+
+    memory.resize(size * 4096);
+    for (auto& reg: V)     reg.assign(size, 0);
+    for (auto& row: stack) row.assign(size, 0);
+    SP.assign(size, 0), DT.assign(size, 0), ST.assign(size, 0);
+    PC.assign(size, 0), I.assign(size, 0),  OP.assign(size, 0);
+    for (auto& key: keys)  key.assign(size, 0);
+    rng.assign(size, 0), pixels.assign(size * SCREEN_HEIGHT, 0);
+    cycles.assign(size, 0), remaining.assign(size, 0), mask.assign(size, 0), fault.assign(size, 0);
+
+    for (std::size_t lane = 0; lane < size; lane++) Reset(lane), Seed(lane, 0);
+}
+
+// Same stream as Chip8::Seed()
+void Lockstep::Seed(std::size_t lane, std::uint64_t seed) {
+    auto z = seed + 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    rng[lane] = (z ^ (z >> 31)) | (z == 0);
+}
+
+bool Lockstep::PressKey(std::size_t lane, char key) {
+    int idx = Keyboard::Map(key);
+    if (idx < 0) return false;
+    keys[idx][lane] = Keyboard::Pressed(keys[idx][lane], hold);
+    return true;
+}
+
+bool Lockstep::ReleaseKey(std::size_t lane, char key) {
+    int idx = Keyboard::Map(key);
+    if (idx < 0) return false;
+    keys[idx][lane] = 0;
+    return true;
+}
+
+// Like Chip8::Reset(), the keys, random state and cycle count carry on
+void Lockstep::Reset(std::size_t lane) {
+    std::copy(image.begin(), image.end(), Memory(lane));
+    std::fill_n(&pixels[lane * SCREEN_HEIGHT], SCREEN_HEIGHT, 0);
+    for (auto& reg: V) reg[lane] = 0;
+    SP[lane] = DT[lane] = ST[lane] = 0;
+    I[lane] = OP[lane] = 0;
+    PC[lane] = ENTRY_POINT;
+    fault[lane] = 0;
+}
+
+std::uint64_t Lockstep::FrameHash(std::size_t lane) const {
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (int row = 0; row < SCREEN_HEIGHT; row++)
+        hash = (hash ^ pixels[lane * SCREEN_HEIGHT + row]) * 0x100000001b3;
+    return hash;
+}
+
+void Lockstep::Load(std::size_t lane, const Chip8& c8) {
+    if (c8.quirks != Quirks::DEFAULT)
+        throw std::runtime_error("chip8: Lockstep runs the default quirks only");
+    auto* lane_memory = Memory(lane);
+    std::copy(c8.memory.begin(), c8.memory.end(), lane_memory);
+    for (std::size_t address = 0; address < 4096; address++)
+        written[address] |= lane_memory[address] != image[address];
+
+    for (int x = 0; x < 16; x++) V[x][lane] = c8.V[x];
+    SP[lane] = c8.SP;
+    for (std::size_t depth = 0; depth < c8.SP; depth++) stack[depth][lane] = c8.stack[depth];
+    PC[lane] = c8.PC, I[lane] = c8.I, OP[lane] = c8.OP;
+    DT[lane] = c8.DT, ST[lane] = c8.ST;
+    for (int k = 0; k < 16; k++) keys[k][lane] = c8.hexpad.keys[k];
+    rng[lane]    = c8.rng;
+    cycles[lane] = c8.cycles;
+    std::copy(c8.pixels.begin(), c8.pixels.end(), &pixels[lane * SCREEN_HEIGHT]);
+    fault[lane] = 0;
+}
+
+void Lockstep::Store(std::size_t lane, Chip8& c8) const {
+    std::copy_n(Memory(lane), 4096, c8.memory.begin());
+    for (int x = 0; x < 16; x++) c8.V[x] = V[x][lane];
+    c8.SP = SP[lane];
+    for (std::size_t depth = 0; depth < SP[lane]; depth++) c8.stack[depth] = stack[depth][lane];
+    c8.PC = PC[lane], c8.I = I[lane], c8.OP = OP[lane];
+    c8.DT = DT[lane], c8.ST = ST[lane];
+    for (int k = 0; k < 16; k++) c8.hexpad.keys[k] = keys[k][lane];
+    c8.rng    = rng[lane];
+    c8.cycles = cycles[lane];
+    std::copy_n(&pixels[lane * SCREEN_HEIGHT], SCREEN_HEIGHT, c8.pixels.begin());
+    c8.dirty_rows = ~0u;
+    c8.Invalidate(0, c8.memory.size());
+}
+
+void Lockstep::UpdateTimers() {
+    auto* dt = DT.data(), * st = ST.data();
+    for (std::size_t l = 0, lanes = size; l < lanes; l++) dt[l] -= dt[l] > 0, st[l] -= st[l] > 0;
+    for (auto& key: keys) {
+        auto* state = key.data();
+        for (std::size_t l = 0, lanes = size; l < lanes; l++) state[l] = Keyboard::Decayed(state[l]);
+    }
+}
+
+// In chunks so that the per-lane budget fits 32 bits, twice the lanes per vector
+void Lockstep::Run(std::uint64_t count) {
+    while (count) {
+        chunk = static_cast<std::uint32_t>(std::min<std::uint64_t>(count, 1u << 30));
+        count -= chunk;
+
+        const std::size_t lanes = size;
+        const auto* counter = PC.data();
+        const auto* left    = remaining.data();
+        for (std::size_t l = 0; l < lanes; l++) remaining[l] = fault[l] ? 0 : chunk;
+        for (;;) {
+            std::uint32_t pc = NO_LANE;
+            for (std::size_t l = 0; l < lanes; l++)
+                pc = std::min<std::uint32_t>(pc, left[l] ? counter[l] : NO_LANE);
+            if (pc == NO_LANE) break;
+            Step(pc);
+        }
+        for (std::size_t l = 0; l < lanes; l++) cycles[l] += fault[l] ? 0 : chunk;
+    }
+}
+
+// A faulting lane stops on the instruction that trapped, as Chip8::Trap()
+// does, and keeps the instructions it ran before it in this chunk
+void Lockstep::Fault(std::size_t lane) {
+    fault[lane] = 1;
+    PC[lane] -= 2;
+    cycles[lane] += chunk - remaining[lane] - 1;
+    remaining[lane] = 0;
+}
+
+void Lockstep::Written(std::uint16_t address, std::size_t length) {
+    for (std::size_t i = 0; i < length; i++) written[(address + i) & 0xfff] = true;
+}
+
+void Lockstep::Step(std::uint16_t pc) {
+    const std::size_t lanes = size;
+    auto lo = pc & 0xfff, hi = (pc + 1) & 0xfff;
+    std::uint16_t op = image[lo] << 8 | image[hi];
+
+    auto* m = mask.data();
+    auto* counter = PC.data(), * last = OP.data();
+    auto* left = remaining.data();
+    for (std::size_t l = 0; l < lanes; l++) m[l] = counter[l] == pc && left[l];
+
+    // Stores may have left different code on some lanes: run the first
+    // lane's instruction, the others wait for a later step
+    if (written[lo] || written[hi]) {
+        bool first = true;
+        for (std::size_t l = 0; l < lanes; l++) {
+            if (!m[l]) continue;
+            std::uint16_t lane_op = Memory(l)[lo] << 8 | Memory(l)[hi];
+            if (first) op = lane_op, first = false;
+            m[l] = lane_op == op;
+        }
+    }
+
+    for (std::size_t l = 0; l < lanes; l++) {
+        counter[l] = m[l] ? pc + 2 : counter[l];
+        last[l]    = m[l] ? op : last[l];
+        left[l]   -= m[l];
+    }
+    Execute(op);
+    steps++;
+}
+
+// The lanes outside the mask must come out unchanged: every kernel is a
+// select between the new and the old value, so the loops stay branch-free.
+void Lockstep::Execute(std::uint16_t op) {
+    const auto x = X(op), y = Y(op), n = N(op);
+    const std::uint8_t  nn  = NN(op);
+    const std::uint16_t nnn = NNN(op);
+
+    // Locals: byte stores may alias any member, these they cannot
+    const std::size_t lanes = size;
+    const std::uint8_t* m = mask.data();
+    auto* vx = V[x].data(), * vy = V[y].data(), * vf = V[0xf].data(), * v0 = V[0].data();
+    auto* pc = PC.data(), * index = I.data();
+    auto* dt = DT.data(), * st = ST.data();
+    auto* state = rng.data();
+
+    switch (Decode(op)) {
+        case Opcode::SYS:
+        case Opcode::UNKNOWN:
+        case Opcode::COUNT:
+        case Opcode::SCD: case Opcode::SCR: case Opcode::SCL: case Opcode::EXIT: // SUPER-CHIP, off
+        case Opcode::LOW: case Opcode::HIGH: case Opcode::LD_HF_VX:
+        case Opcode::LD_R_VX: case Opcode::LD_VX_R:
+            break;
+        case Opcode::CLS:
+            for (std::size_t l = 0; l < lanes; l++)
+                if (m[l]) std::fill_n(&pixels[l * SCREEN_HEIGHT], SCREEN_HEIGHT, 0);
+            break;
+        case Opcode::RET:
+            for (std::size_t l = 0; l < lanes; l++) {
+                if (!m[l]) continue;
+                if (SP[l] == 0) Fault(l);
+                else pc[l] = stack[--SP[l]][l];
+            }
+            break;
+        case Opcode::CALL:
+            for (std::size_t l = 0; l < lanes; l++) {
+                if (!m[l]) continue;
+                if (SP[l] == stack.size()) Fault(l);
+                else stack[SP[l]++][l] = pc[l], pc[l] = nnn;
+            }
+            break;
+        case Opcode::JP:
+            for (std::size_t l = 0; l < lanes; l++) pc[l] = m[l] ? nnn : pc[l];
+            break;
+        case Opcode::JP_V0:
+            for (std::size_t l = 0; l < lanes; l++) pc[l] = m[l] ? v0[l] + nnn : pc[l];
+            break;
+        case Opcode::SE_VX_NN:
+            for (std::size_t l = 0; l < lanes; l++) pc[l] += (m[l] & (vx[l] == nn)) << 1;
+            break;
+        case Opcode::SNE_VX_NN:
+            for (std::size_t l = 0; l < lanes; l++) pc[l] += (m[l] & (vx[l] != nn)) << 1;
+            break;
+        case Opcode::SE_VX_VY:
+            for (std::size_t l = 0; l < lanes; l++) pc[l] += (m[l] & (vx[l] == vy[l])) << 1;
+            break;
+        case Opcode::SNE_VX_VY:
+            for (std::size_t l = 0; l < lanes; l++) pc[l] += (m[l] & (vx[l] != vy[l])) << 1;
+            break;
+        case Opcode::LD_VX_NN:
+            for (std::size_t l = 0; l < lanes; l++) vx[l] = m[l] ? nn : vx[l];
+            break;
+        case Opcode::ADD_VX_NN:
+            for (std::size_t l = 0; l < lanes; l++) vx[l] = m[l] ? vx[l] + nn : vx[l];
+            break;
+        case Opcode::LD_VX_VY:
+            for (std::size_t l = 0; l < lanes; l++) vx[l] = m[l] ? vy[l] : vx[l];
+            break;
+        case Opcode::OR:
+            for (std::size_t l = 0; l < lanes; l++) vx[l] = m[l] ? vx[l] | vy[l] : vx[l];
+            break;
+        case Opcode::AND:
+            for (std::size_t l = 0; l < lanes; l++) vx[l] = m[l] ? vx[l] & vy[l] : vx[l];
+            break;
+        case Opcode::XOR:
+            for (std::size_t l = 0; l < lanes; l++) vx[l] = m[l] ? vx[l] ^ vy[l] : vx[l];
+            break;
+        // VF first, then VX read again: x or y may be 0xf, as in the handlers
+        case Opcode::ADD_VX_VY:
+            for (std::size_t l = 0; l < lanes; l++) {
+                vf[l] = m[l] ? vx[l] + vy[l] > 0xff : vf[l];
+                vx[l] = m[l] ? vx[l] + vy[l] : vx[l];
+            }
+            break;
+        case Opcode::SUB:
+            for (std::size_t l = 0; l < lanes; l++) {
+                vf[l] = m[l] ? vx[l] > vy[l] : vf[l];
+                vx[l] = m[l] ? vx[l] - vy[l] : vx[l];
+            }
+            break;
+        case Opcode::SHR:
+            for (std::size_t l = 0; l < lanes; l++) {
+                vf[l] = m[l] ? vx[l] & 0x1 : vf[l];
+                vx[l] = m[l] ? vx[l] >> 1 : vx[l];
+            }
+            break;
+        case Opcode::SUBN:
+            for (std::size_t l = 0; l < lanes; l++) {
+                vf[l] = m[l] ? vy[l] > vx[l] : vf[l];
+                vx[l] = m[l] ? vy[l] - vx[l] : vx[l];
+            }
+            break;
+        case Opcode::SHL:
+            for (std::size_t l = 0; l < lanes; l++) {
+                vf[l] = m[l] ? vx[l] >> 7 : vf[l];
+                vx[l] = m[l] ? vx[l] << 1 : vx[l];
+            }
+            break;
+        case Opcode::LD_I:
+            for (std::size_t l = 0; l < lanes; l++) index[l] = m[l] ? nnn : index[l];
+            break;
+        case Opcode::RND: // Chip8::Random()
+            for (std::size_t l = 0; l < lanes; l++) {
+                auto r = state[l];
+                r ^= r >> 12, r ^= r << 25, r ^= r >> 27;
+                state[l] = m[l] ? r : state[l];
+                vx[l]  = m[l] ? ((r * 0x2545f4914f6cdd1d) >> 56) & nn : vx[l];
+            }
+            break;
+        case Opcode::DRW:
+            for (std::size_t l = 0; l < lanes; l++) {
+                if (!m[l]) continue;
+                auto* rows = &pixels[l * SCREEN_HEIGHT];
+                auto* lane_memory = Memory(l);
+                auto col = vx[l] % SCREEN_WIDTH, top = vy[l] % SCREEN_HEIGHT;
+                std::uint64_t collision = 0;
+                for (int row = 0; row < n; row++) {
+                    std::uint64_t line = static_cast<std::uint64_t>(lane_memory[(index[l] + row) & 0xfff]) << 56;
+                    line = col ? (line >> col | line << (SCREEN_WIDTH - col)) : line;
+                    auto& dst = rows[(top + row) % SCREEN_HEIGHT];
+                    collision |= dst & line;
+                    dst ^= line;
+                }
+                vf[l] = collision != 0;
+            }
+            break;
+        // The key is a per-lane gather over the 16 key rows, see Chip8::op_ex9e()
+        case Opcode::SKP:
+            for (std::size_t l = 0; l < lanes; l++) {
+                bool down = (vx[l] < 16) & Keyboard::IsDown(keys[vx[l] & 0xf][l]);
+                pc[l] += (m[l] & down) << 1;
+            }
+            break;
+        case Opcode::SKNP:
+            for (std::size_t l = 0; l < lanes; l++) {
+                bool down = (vx[l] < 16) & Keyboard::IsDown(keys[vx[l] & 0xf][l]);
+                pc[l] += (m[l] & !down) << 1;
+            }
+            break;
+        case Opcode::LD_VX_K: // Lowest latched key, as Keyboard::Take()
+            for (std::size_t l = 0; l < lanes; l++) {
+                if (!m[l]) continue;
+                int key = 0;
+                while (key < 16 && !(keys[key][l] & Keyboard::LATCH)) key++;
+                if (key < 16) vx[l] = key, keys[key][l] &= ~Keyboard::LATCH;
+                else pc[l] -= 2;
+            }
+            break;
+        case Opcode::LD_VX_DT:
+            for (std::size_t l = 0; l < lanes; l++) vx[l] = m[l] ? dt[l] : vx[l];
+            break;
+        case Opcode::LD_DT_VX:
+            for (std::size_t l = 0; l < lanes; l++) dt[l] = m[l] ? vx[l] : dt[l];
+            break;
+        case Opcode::LD_ST_VX:
+            for (std::size_t l = 0; l < lanes; l++) st[l] = m[l] ? vx[l] : st[l];
+            break;
+        case Opcode::ADD_I_VX:
+            for (std::size_t l = 0; l < lanes; l++) index[l] += m[l] ? vx[l] : 0;
+            break;
+        case Opcode::LD_F_VX:
+            for (std::size_t l = 0; l < lanes; l++) index[l] = m[l] ? FONT_ADDRESS + vx[l] * 5 : index[l];
+            break;
+        case Opcode::LD_B_VX:
+            for (std::size_t l = 0; l < lanes; l++) {
+                if (!m[l]) continue;
+                auto* lane_memory = Memory(l);
+                lane_memory[index[l] & 0xfff]       = vx[l] / 100;
+                lane_memory[(index[l] + 1) & 0xfff] = vx[l] % 100 / 10;
+                lane_memory[(index[l] + 2) & 0xfff] = vx[l] % 10;
+                Written(index[l], 3);
+            }
+            break;
+        case Opcode::LD_MEM_VX:
+            for (std::size_t l = 0; l < lanes; l++) {
+                if (!m[l]) continue;
+                auto* lane_memory = Memory(l);
+                for (int r = 0; r <= x; r++) lane_memory[(index[l] + r) & 0xfff] = V[r][l];
+                Written(index[l], x + 1);
+            }
+            break;
+        case Opcode::LD_VX_MEM:
+            for (std::size_t l = 0; l < lanes; l++) {
+                if (!m[l]) continue;
+                auto* lane_memory = Memory(l);
+                for (int r = 0; r <= x; r++) V[r][l] = lane_memory[(index[l] + r) & 0xfff];
+            }
+            break;
+    }
+}
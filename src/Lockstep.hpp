@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include "Keyboard.hpp"
+#include "RomImage.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Many machines of one ROM, stored as struct-of-arrays lanes and run in
+// lockstep: every step picks the smallest PC among the lanes that still have
+// instructions to run, decodes it once, and applies it to every lane sitting
+// on that PC through a mask. Lanes that took another branch wait, and the
+// smallest-PC-first order brings them back together where paths reconverge.
+// The register kernels are plain selects over contiguous lanes, which the
+// compiler turns into SSE/AVX2 code; draws and memory copies stay per lane.
+//
+// Results match the scalar Chip8, which Load() and Store() convert to and
+// from: fork lanes off a machine, or hand a lane back to it for inspection.
+// A stack overflow or a return with an empty stack faults the lane, which
+// then stops running instead of throwing. Lanes have the default quirks,
+// Load() refuses a machine with others.
+class Lockstep final {
+public:
+    Lockstep(std::shared_ptr<const RomImage> rom, std::size_t lanes);
+
+    std::size_t Size() const { return size; }
+
+    void Run(std::uint64_t count);  // `count` instructions on every lane
+    void UpdateTimers();            // Every lane
+
+    void Seed(std::size_t lane, std::uint64_t seed);
+    bool PressKey(std::size_t lane, char key);
+    bool ReleaseKey(std::size_t lane, char key);
+    void SetKeyHold(std::uint8_t ticks) { hold = ticks; } // Every lane, see Chip8::SetKeyHold()
+    void Reset(std::size_t lane);
+
+    std::uint64_t FrameHash(std::size_t lane) const; // Same as Chip8::FrameHash()
+    bool Faulted(std::size_t lane) const { return fault[lane]; }
+
+    void Load(std::size_t lane, const Chip8& c8);
+    void Store(std::size_t lane, Chip8& c8) const;
+
+    // Instructions issued, each on every lane of its mask: instructions run
+    // over all lanes divided by steps is the average occupancy
+    std::uint64_t steps = 0;
+
+private:
+    std::shared_ptr<const RomImage> rom;
+    std::size_t size;
+
+    std::vector<std::uint8_t>                  memory; // 4096 bytes per lane, lane after lane
+    std::array<std::vector<std::uint8_t>,  16> V;      // V[x][lane]
+    std::array<std::vector<std::uint16_t>, 16> stack;  // stack[depth][lane]
+    std::vector<std::uint8_t>  SP, DT, ST;
+    std::vector<std::uint16_t> PC, I, OP;
+    std::array<std::vector<std::uint8_t>, 16> keys; // keys[k][lane], as in Keyboard
+    std::vector<std::uint64_t> rng;
+    std::vector<std::uint64_t> pixels;    // 32 rows per lane, lane after lane
+    std::vector<std::uint64_t> cycles;
+    std::vector<std::uint32_t> remaining; // Instructions left in this chunk of Run()
+    std::vector<std::uint8_t>  mask;      // 1 on the lanes the current step runs on
+    std::vector<std::uint8_t>  fault;
+
+    std::array<std::uint8_t, 4096> image   = { }; // Font and ROM, as every lane starts
+    std::array<bool,         4096> written = { }; // Some lane may differ from `image` here
+
+    std::uint8_t  hold  = Keyboard::HOLD;
+    std::uint32_t chunk = 0; // Instructions per lane in this chunk of Run()
+
+    void Step(std::uint16_t pc);
+    void Execute(std::uint16_t OP);
+    void Fault(std::size_t lane);
+
+    std::uint8_t* Memory(std::size_t lane) { return &memory[lane * 4096]; }
+    const std::uint8_t* Memory(std::size_t lane) const { return &memory[lane * 4096]; }
+    void Written(std::uint16_t address, std::size_t length);
+};
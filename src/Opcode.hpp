@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Every Chip-8 instruction, in the order of the README's instruction table,
+// then the SUPER-CHIP ones. Without Quirks::SCHIP those run as no-ops, like
+// the SYS and unknown words they used to decode as.
+enum class Opcode : std::uint8_t {
+    SYS,  CLS,  RET,  JP,   CALL, SE_VX_NN, SNE_VX_NN, SE_VX_VY,
+    LD_VX_NN, ADD_VX_NN, LD_VX_VY, OR, AND, XOR, ADD_VX_VY, SUB,
+    SHR,  SUBN, SHL,  SNE_VX_VY, LD_I, JP_V0, RND, DRW,
+    SKP,  SKNP, LD_VX_DT, LD_VX_K, LD_DT_VX, LD_ST_VX, ADD_I_VX, LD_F_VX,
+    LD_B_VX, LD_MEM_VX, LD_VX_MEM,
+    SCD,  SCR,  SCL,  EXIT, LOW,  HIGH, LD_HF_VX, LD_R_VX, LD_VX_R,
+    UNKNOWN, COUNT
+};
+
+constexpr std::size_t OPCODE_COUNT = static_cast<std::size_t>(Opcode::COUNT);
+
+// Switch on the top nibble, then on the sub-opcode bits of each group.
+constexpr Opcode Decode(std::uint16_t OP) {
+    switch (OP >> 12) {
+        case 0x0: switch (OP) {
+            case 0x00e0: return Opcode::CLS;
+            case 0x00ee: return Opcode::RET;
+            case 0x00fb: return Opcode::SCR;
+            case 0x00fc: return Opcode::SCL;
+            case 0x00fd: return Opcode::EXIT;
+            case 0x00fe: return Opcode::LOW;
+            case 0x00ff: return Opcode::HIGH;
+            default:     return (OP & 0xfff0) == 0x00c0 ? Opcode::SCD : Opcode::SYS; }
+        case 0x1: return Opcode::JP;
+        case 0x2: return Opcode::CALL;
+        case 0x3: return Opcode::SE_VX_NN;
+        case 0x4: return Opcode::SNE_VX_NN;
+        case 0x5: return Opcode::SE_VX_VY;
+        case 0x6: return Opcode::LD_VX_NN;
+        case 0x7: return Opcode::ADD_VX_NN;
+        case 0x8: switch (OP & 0x000f) {
+            case 0x0: return Opcode::LD_VX_VY;
+            case 0x1: return Opcode::OR;
+            case 0x2: return Opcode::AND;
+            case 0x3: return Opcode::XOR;
+            case 0x4: return Opcode::ADD_VX_VY;
+            case 0x5: return Opcode::SUB;
+            case 0x6: return Opcode::SHR;
+            case 0x7: return Opcode::SUBN;
+            case 0xe: return Opcode::SHL;
+            default:  return Opcode::UNKNOWN; }
+        case 0x9: return Opcode::SNE_VX_VY;
+        case 0xa: return Opcode::LD_I;
+        case 0xb: return Opcode::JP_V0;
+        case 0xc: return Opcode::RND;
+        case 0xd: return Opcode::DRW;
+        case 0xe: switch (OP & 0x00ff) {
+            case 0x9e: return Opcode::SKP;
+            case 0xa1: return Opcode::SKNP;
+            default:   return Opcode::UNKNOWN; }
+        default: switch (OP & 0x00ff) { // 0xf
+            case 0x07: return Opcode::LD_VX_DT;
+            case 0x0a: return Opcode::LD_VX_K;
+            case 0x15: return Opcode::LD_DT_VX;
+            case 0x18: return Opcode::LD_ST_VX;
+            case 0x1e: return Opcode::ADD_I_VX;
+            case 0x29: return Opcode::LD_F_VX;
+            case 0x30: return Opcode::LD_HF_VX;
+            case 0x33: return Opcode::LD_B_VX;
+            case 0x55: return Opcode::LD_MEM_VX;
+            case 0x65: return Opcode::LD_VX_MEM;
+            case 0x75: return Opcode::LD_R_VX;
+            case 0x85: return Opcode::LD_VX_R;
+            default:   return Opcode::UNKNOWN; }
+    }
+}
+
+// Masked form of each opcode (0x8004, 0xf055...), used as a stable key.
+constexpr std::array<std::uint16_t, OPCODE_COUNT> OpcodeKey {
+    0x0000, 0x00e0, 0x00ee, 0x1000, 0x2000, 0x3000, 0x4000, 0x5000,
+    0x6000, 0x7000, 0x8000, 0x8001, 0x8002, 0x8003, 0x8004, 0x8005,
+    0x8006, 0x8007, 0x800e, 0x9000, 0xa000, 0xb000, 0xc000, 0xd000,
+    0xe09e, 0xe0a1, 0xf007, 0xf00a, 0xf015, 0xf018, 0xf01e, 0xf029,
+    0xf033, 0xf055, 0xf065,
+    0x00c0, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff, 0xf030, 0xf075, 0xf085,
+    0xffff
+};
+
+static_assert(Decode(0x00e0) == Opcode::CLS  && Decode(0x8a3e) == Opcode::SHL &&
+              Decode(0xf265) == Opcode::LD_VX_MEM && Decode(0x5120) == Opcode::SE_VX_VY &&
+              Decode(0x00c4) == Opcode::SCD  && Decode(0xf385) == Opcode::LD_VX_R,
+              "Decode: opcode table out of sync");
@@ -0,0 +1,36 @@
+#include "Profiler.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+void Profiler::Dump(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) throw std::runtime_error("chip8: Failed to open " + filename);
+
+    char key[8];
+    auto hex = [&key](unsigned value) { std::snprintf(key, sizeof(key), "0x%04x", value); return key; };
+
+    std::uint64_t total = 0;
+    for (auto count: opcodes) total += count;
+
+    file << "{\n  \"instructions\": " << total << ",\n"
+         << "  \"pixel_flips\": " << pixel_flips << ",\n"
+         << "  \"collisions\": " << collisions << ",\n"
+         << "  \"stack_high_water\": " << stack_high_water << ",\n"
+         << "  \"opcodes\": {";
+    bool first = true;
+    for (std::size_t op = 0; op < OPCODE_COUNT; op++) {
+        if (!opcodes[op]) continue;
+        file << (first ? "\n" : ",\n") << "    \"" << hex(OpcodeKey[op]) << "\": " << opcodes[op];
+        first = false;
+    }
+    file << "\n  },\n  \"addresses\": {";
+    first = true;
+    for (std::size_t address = 0; address < addresses.size(); address++) {
+        if (!addresses[address]) continue;
+        file << (first ? "\n" : ",\n") << "    \"" << hex(address) << "\": " << addresses[address];
+        first = false;
+    }
+    file << "\n  }\n}\n";
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Opcode.hpp"
+
+#include <array>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+// Build with -DCHIP8_PROFILE (make profile) to compile the counters in,
+// otherwise PROFILE() expands to nothing and the core pays nothing.
+#ifdef CHIP8_PROFILE
+    #define PROFILE(...) __VA_ARGS__
+#else
+    #define PROFILE(...)
+#endif
+
+// Execution counters of one Chip8, updated from the interpreter's hot path
+struct Profiler {
+    std::array<std::uint64_t, OPCODE_COUNT> opcodes   = { }; // Per Opcode
+    std::array<std::uint64_t, 4096>         addresses = { }; // Per PC
+    std::uint64_t pixel_flips      = 0; // Pixels toggled by DXYN
+    std::uint64_t collisions       = 0; // DXYN that set VF
+    std::size_t   stack_high_water = 0; // Deepest call stack seen
+
+    inline void Count(Opcode op, std::uint16_t address) {
+        opcodes[static_cast<std::size_t>(op)]++;
+        addresses[address & 0xfff]++;
+    }
+
+    inline void Stack(std::size_t depth) {
+        stack_high_water = std::max(stack_high_water, depth);
+    }
+
+    void Dump(const std::string& filename) const; // As JSON
+};
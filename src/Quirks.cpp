@@ -0,0 +1,66 @@
+#include "Quirks.hpp"
+#include "Disassembler.hpp"
+
+#include <array>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    struct Named { const char* name; std::uint8_t quirks; };
+
+    constexpr std::array<Named, 3> Profiles {{
+        {"default", Quirks::DEFAULT}, {"vip", Quirks::VIP}, {"schip", Quirks::SUPERCHIP},
+    }};
+
+    constexpr std::array<Named, 5> Flags {{
+        {"shift", Quirks::SHIFT_VY}, {"index", Quirks::INDEX}, {"jump", Quirks::JUMP_VX},
+        {"clip",  Quirks::CLIP},     {"super", Quirks::SCHIP},
+    }};
+
+    // ROMs that run wrong under the opcodes they use, by RomImage::Hash()
+    struct Known { std::uint64_t hash; std::uint8_t quirks; };
+    constexpr std::array<Known, 1> KnownRoms {{
+        {0x29bcab9b664d212b, Quirks::CLIP}, // roms/blitz.ch8: draws past the bottom, wrapped it collides
+    }};
+}
+
+std::uint8_t Quirks::Parse(const std::string& text) {
+    for (auto& profile: Profiles)
+        if (text == profile.name) return profile.quirks;
+
+    std::uint8_t quirks = 0;
+    std::istringstream flags(text);
+    for (std::string flag; std::getline(flags, flag, ','); ) {
+        auto it = std::find_if(Flags.begin(), Flags.end(), [&](auto& f) { return flag == f.name; });
+        if (it == Flags.end()) throw std::runtime_error("chip8: Unknown quirk " + flag);
+        quirks |= it->quirks;
+    }
+    return quirks;
+}
+
+std::string Quirks::Name(std::uint8_t quirks) {
+    for (auto& profile: Profiles)
+        if (quirks == profile.quirks) return profile.name;
+    std::string name;
+    for (auto& flag: Flags)
+        if (quirks & flag.quirks) name += (name.empty() ? "" : ",") + std::string(flag.name);
+    return name;
+}
+
+std::uint8_t Quirks::Detect(const RomImage& rom) {
+    for (auto& known: KnownRoms)
+        if (rom.Hash() == known.hash) return known.quirks;
+
+    for (auto& line: Disassembler::Disassemble(rom)) {
+        switch (line.op) {
+            case Opcode::SCD: case Opcode::SCR: case Opcode::SCL: case Opcode::EXIT:
+            case Opcode::LOW: case Opcode::HIGH: case Opcode::LD_HF_VX:
+            case Opcode::LD_R_VX: case Opcode::LD_VX_R:
+                return SUPERCHIP;
+            default:
+                break;
+        }
+    }
+    return DEFAULT;
+}
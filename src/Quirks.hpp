@@ -0,0 +1,36 @@
+#pragma once
+
+#include "RomImage.hpp"
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Behaviors that differ between Chip-8 interpreters, one bit each. They are
+// template arguments of Chip8's interpreter loop and of the handlers they
+// change, so every combination is its own interpreter and an instruction
+// never tests them; Chip8::SetQuirks() picks the instantiation.
+struct Quirks {
+    enum : std::uint8_t {
+        SHIFT_VY = 1 << 0, // 8XY6/8XYE shift VY into VX, not VX in place
+        INDEX    = 1 << 1, // FX55/FX65 leave I past the last register
+        JUMP_VX  = 1 << 2, // BXNN jumps to XNN + VX, not NNN + V0
+        CLIP     = 1 << 3, // Sprites stop at the screen edges instead of wrapping
+        SCHIP    = 1 << 4, // SUPER-CHIP: 128x64 mode, scrolling, 16x16 sprites, big font, flags
+    };
+
+    static constexpr std::size_t  COUNT = 1 << 5; // Combinations, interpreters
+
+    static constexpr std::uint8_t DEFAULT   = 0;                        // As this emulator always ran
+    static constexpr std::uint8_t VIP       = SHIFT_VY | INDEX | CLIP;  // COSMAC VIP
+    static constexpr std::uint8_t SUPERCHIP = JUMP_VX | CLIP | SCHIP;   // SUPER-CHIP 1.1
+
+    // "default", "vip", "schip", or flags joined by ',' ("shift,clip"), named
+    // shift, index, jump, clip and super in the order above; throws otherwise
+    static std::uint8_t Parse(const std::string& text);
+    static std::string  Name(std::uint8_t quirks); // Profile name, or the flags
+
+    // Known ROMs by hash, then SUPER-CHIP for ROMs whose reachable code uses
+    // its opcodes, DEFAULT for everything else
+    static std::uint8_t Detect(const RomImage& rom);
+};
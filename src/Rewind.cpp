@@ -0,0 +1,102 @@
+#include "Rewind.hpp"
+
+#include <stdexcept>
+
+Rewind::Rewind(std::size_t capacity, std::size_t interval)
+: capacity(capacity), interval(interval ? interval : 1) { }
+
+void Rewind::Push(const Chip8& c8) {
+    c8.SaveState(state);
+
+    Frame frame;
+    if ((frame.keyframe = frames.empty() || since_keyframe + 1 >= interval)) {
+        frame.data = state;
+        since_keyframe = 0;
+    } else {
+        Encode(LatestKeyframe(), state, frame.data);
+        since_keyframe++;
+    }
+
+    bytes += frame.data.size();
+    frames.push_back(std::move(frame));
+    Evict();
+}
+
+bool Rewind::Pop(Chip8& c8) {
+    if (frames.empty()) return false;
+
+    auto& frame = frames.back();
+    if (frame.keyframe) c8.LoadState(frame.data);
+    else Decode(LatestKeyframe(), frame.data, state), c8.LoadState(state);
+
+    bytes -= frame.data.size();
+    frames.pop_back();
+
+    // Deltas left after the keyframe that is now the latest one
+    since_keyframe = 0;
+    for (auto it = frames.rbegin(); it != frames.rend() && !it->keyframe; ++it)
+        since_keyframe++;
+    return true;
+}
+
+const std::vector<std::uint8_t>& Rewind::LatestKeyframe() const {
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+        if (it->keyframe) return it->data;
+    throw std::runtime_error("chip8: Rewind history without keyframe");
+}
+
+// Over budget: the oldest keyframe goes with all of its deltas, the group
+// being recorded into is always kept.
+void Rewind::Evict() {
+    while (bytes > capacity && frames.size() > since_keyframe + 1) {
+        do {
+            bytes -= frames.front().data.size();
+            frames.pop_front();
+        } while (!frames.empty() && !frames.front().keyframe);
+    }
+}
+
+// Delta format, repeated: varint count of unchanged bytes, varint count of
+// changed bytes, then the changed bytes XORed with the keyframe.
+static void PutVarint(std::vector<std::uint8_t>& out, std::size_t value) {
+    for (; value >= 0x80; value >>= 7) out.push_back((value & 0x7f) | 0x80);
+    out.push_back(value);
+}
+
+static std::size_t GetVarint(const std::uint8_t*& in) {
+    std::size_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        value |= std::size_t(*in & 0x7f) << shift;
+        if (!(*in++ & 0x80)) return value;
+    }
+}
+
+void Rewind::Encode(const std::vector<std::uint8_t>& key,
+                    const std::vector<std::uint8_t>& state, std::vector<std::uint8_t>& delta) {
+    delta.clear();
+    std::size_t i = 0, size = state.size();
+    while (i < size) {
+        auto start = i;
+        while (i < size && state[i] == key[i]) i++;
+        PutVarint(delta, i - start);
+        if (i == size) break;
+
+        start = i;
+        while (i < size && state[i] != key[i]) i++;
+        PutVarint(delta, i - start);
+        for (auto j = start; j < i; j++) delta.push_back(state[j] ^ key[j]);
+    }
+}
+
+void Rewind::Decode(const std::vector<std::uint8_t>& key,
+                    const std::vector<std::uint8_t>& delta, std::vector<std::uint8_t>& state) {
+    state = key;
+    const std::uint8_t* in  = delta.data();
+    const std::uint8_t* end = delta.data() + delta.size();
+    std::size_t i = 0;
+    while (in < end) {
+        i += GetVarint(in);
+        if (in >= end) break;
+        for (auto changed = GetVarint(in); changed; changed--) state[i++] ^= *in++;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Chip8.hpp"
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Rewind history: one snapshot per frame in a ring bounded by `capacity`
+// bytes. Every `interval` frames a keyframe holds a full save state, the
+// frames in between only hold their XOR against that keyframe, run-length
+// encoded, which is mostly zeros: a few dozen bytes per frame.
+class Rewind final {
+public:
+    explicit Rewind(std::size_t capacity = 64 << 20, std::size_t interval = 60);
+
+    void Push(const Chip8& c8); // Record the current frame
+    bool Pop(Chip8& c8);        // Restore the latest frame and forget it
+
+    std::size_t Frames() const { return frames.size(); }
+    std::size_t Bytes()  const { return bytes; }
+
+private:
+    struct Frame {
+        bool                      keyframe;
+        std::vector<std::uint8_t> data; // Save state, or delta to its keyframe
+    };
+
+    std::deque<Frame> frames;
+    std::size_t       capacity;
+    std::size_t       interval;
+    std::size_t       bytes = 0;
+    std::size_t       since_keyframe = 0;  // Deltas after the latest keyframe
+
+    std::vector<std::uint8_t> state;       // Scratch save state
+
+    const std::vector<std::uint8_t>& LatestKeyframe() const;
+    void Evict();
+
+    static void Encode(const std::vector<std::uint8_t>& key,
+                       const std::vector<std::uint8_t>& state, std::vector<std::uint8_t>& delta);
+    static void Decode(const std::vector<std::uint8_t>& key,
+                       const std::vector<std::uint8_t>& delta, std::vector<std::uint8_t>& state);
+};
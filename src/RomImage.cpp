@@ -0,0 +1,86 @@
+#include "RomImage.hpp"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+constexpr std::size_t ROM_MAX_SIZE = 4096 - 0x200; // Memory past the entry point
+
+// Cached by file identity, not only by path: a file rewritten in place or
+// replaced under the same name gets a new image. The path must match too,
+// Filename() names the state and trace files. Pipes and the like are read
+// anew every time.
+std::shared_ptr<const RomImage> RomImage::Load(const std::string& filename) {
+    using Identity = std::tuple<dev_t, ino_t, time_t, long, off_t>; // Device, inode, mtime, size
+    static std::mutex mutex;
+    static std::map<Identity, std::weak_ptr<const RomImage>> cache;
+
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+        return std::shared_ptr<const RomImage>(new RomImage(filename)); // Throws if it cannot be opened
+    Identity identity {info.st_dev, info.st_ino, info.st_mtim.tv_sec, info.st_mtim.tv_nsec, info.st_size};
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = cache.begin(); it != cache.end(); ) // Images nobody holds anymore
+        it = it->second.expired() ? cache.erase(it) : std::next(it);
+    if (auto it = cache.find(identity); it != cache.end())
+        if (auto image = it->second.lock(); image && image->filename == filename) return image;
+
+    std::shared_ptr<const RomImage> image(new RomImage(filename));
+    cache[identity] = image;
+    return image;
+}
+
+std::shared_ptr<const RomImage> RomImage::FromBytes(const std::string& name,
+                                                    std::vector<std::uint8_t> bytes) {
+    return std::shared_ptr<const RomImage>(new RomImage(name, std::move(bytes)));
+}
+
+RomImage::RomImage(const std::string& filename): filename(filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("chip8: Failed to open file");
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        size   = info.st_size;
+        mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) mapped = nullptr;
+    }
+    close(fd);
+
+    if (mapped) data = static_cast<const std::uint8_t*>(mapped);
+    else { // Pipes, empty files, filesystems without mmap
+        std::ifstream file(filename, std::ios::binary);
+        owned.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = owned.data(), size = owned.size();
+    }
+    Validate();
+}
+
+RomImage::RomImage(const std::string& name, std::vector<std::uint8_t> bytes)
+: filename(name), owned(std::move(bytes)) {
+    data = owned.data(), size = owned.size();
+    Validate();
+}
+
+RomImage::~RomImage() {
+    if (mapped) munmap(mapped, size);
+}
+
+void RomImage::Validate() {
+    if (size > ROM_MAX_SIZE) {
+        if (mapped) munmap(mapped, size), mapped = nullptr;
+        throw std::runtime_error("chip8: Failed to fit ROM in memory");
+    }
+    hash = 0xcbf29ce484222325;
+    for (std::size_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * 0x100000001b3;
+}
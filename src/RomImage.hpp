@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A ROM file loaded once, mapped read-only when possible, and shared by
+// every Chip8, Disassembler and Display that asks for the same file while
+// it stays unchanged.
+class RomImage final {
+public:
+    // Loaded on first use, then shared for as long as someone holds it and
+    // the file keeps its inode, modification time and size
+    static std::shared_ptr<const RomImage> Load(const std::string& filename);
+
+    // From bytes already in memory (generated programs, tests)
+    static std::shared_ptr<const RomImage> FromBytes(const std::string& name,
+                                                     std::vector<std::uint8_t> bytes);
+
+    ~RomImage();
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+
+    const std::uint8_t* Data()     const { return data; }
+    std::size_t         Size()     const { return size; }
+    std::uint64_t       Hash()     const { return hash; }  // FNV-1a of the content
+    const std::string&  Filename() const { return filename; }
+
+private:
+    explicit RomImage(const std::string& filename);
+    RomImage(const std::string& name, std::vector<std::uint8_t> bytes);
+
+    std::string               filename;
+    const std::uint8_t*       data   = nullptr;
+    std::size_t               size   = 0;
+    std::uint64_t             hash   = 0;
+    void*                     mapped = nullptr; // mmap'd region, if any
+    std::vector<std::uint8_t> owned;            // Otherwise, the bytes read
+
+    void Validate();
+};
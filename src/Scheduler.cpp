@@ -0,0 +1,66 @@
+#include "Scheduler.hpp"
+
+#include <cerrno>
+
+constexpr long FRAME_NS = 1000000000L / FRAME_RATE;
+
+static void Advance(timespec& ts, long ns) {
+    ts.tv_nsec += ns;
+    ts.tv_sec  += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+}
+
+static bool Before(const timespec& a, const timespec& b) {
+    return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+Scheduler::Scheduler(Chip8& c8, FrameExport* output): c8(c8), output(output) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+}
+
+// cycle_speed/60 is rarely whole (2.5 at 150Hz), the remainder carries over
+std::uint64_t Scheduler::FrameCycles() {
+    budget += c8.cycle_speed / FRAME_RATE;
+    auto cycles = static_cast<std::uint64_t>(budget);
+    budget -= cycles;
+    return cycles;
+}
+
+void Scheduler::Frame() {
+    if (c8.rewind) { while (c8.rewind && history.Pop(c8)) c8.rewind--; c8.rewind = 0; return; }
+    if (c8.paused) return c8.Cycle(); // Single steps only
+
+    if (!c8.unthrottled) {
+        history.Push(c8);
+        c8.Run(FrameCycles());
+        c8.UpdateTimers();
+        if (output) output->Publish(c8);
+        return;
+    }
+
+    // Emulated frames back to back: emulated time follows the instruction
+    // count, the wall clock only decides when to hand back for input and a
+    // screen refresh.
+    timespec now, end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    Advance(end, FRAME_NS);
+    do {
+        history.Push(c8);
+        c8.Run(FrameCycles());
+        c8.UpdateTimers();
+        if (output) output->Publish(c8);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (Before(now, end));
+}
+
+void Scheduler::Wait() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    Advance(deadline, FRAME_NS);
+
+    if (c8.unthrottled || !Before(now, deadline)) { // Running late, resync
+        deadline = now;
+        return;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include "FrameExport.hpp"
+#include "Rewind.hpp"
+
+#include <ctime>
+#include <cstdint>
+
+#define FRAME_RATE 60 // Timers and screen refresh, in Hertz
+
+// Paces the emulator in 60Hz frames: each frame runs cycle_speed/60
+// instructions and ticks the timers once, then the thread sleeps until the
+// next frame is due. Unthrottled, frames run back to back for a frame's
+// worth of wall time, and the timers tick every cycle_speed/60 instructions.
+// The state at the start of every frame goes into the rewind history, the
+// one at its end to `output` when there is one. Rewinds pop a frame each
+// and run nothing; the Emulator pauses on them, so holding the key keeps
+// going back instead of racing the frames pushed meanwhile.
+class Scheduler final {
+public:
+    explicit Scheduler(Chip8& c8, FrameExport* output = nullptr);
+
+    void Frame(); // Instructions and timers of one frame
+    void Wait();  // Sleep until the next frame, returns at once if unthrottled
+
+private:
+    Chip8&       c8;
+    FrameExport* output;
+    Rewind       history;
+
+    timespec deadline;     // Start of the next frame, CLOCK_MONOTONIC
+    double   budget = 0.0; // Fraction of an instruction carried over
+
+    std::uint64_t FrameCycles();
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between exactly one producer and one consumer
+// thread. `N` must be a power of two; Push() fails instead of blocking when
+// the queue is full.
+template <typename T, std::size_t N>
+class SpscQueue final {
+    static_assert(N && !(N & (N - 1)), "SpscQueue size must be a power of two");
+
+public:
+    bool Push(const T& item) {
+        auto tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - head.load(std::memory_order_acquire) == N) return false;
+        items[tail & (N - 1)] = item;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& item) {
+        auto head = this->head.load(std::memory_order_relaxed);
+        if (head == tail.load(std::memory_order_acquire)) return false;
+        item = items[head & (N - 1)];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<std::size_t> head { 0 }; // Next to pop, consumer owned
+    alignas(64) std::atomic<std::size_t> tail { 0 }; // Next to push, producer owned
+    std::array<T, N> items;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+// Work-stealing pool: every worker owns a deque, pops its own work from the
+// back and steals from the front of the others once it runs dry.
+class ThreadPool final {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(std::size_t threads)
+    : queues(threads ? threads : 1) { }
+
+    // Tasks are dealt round-robin, call before Run()
+    void Submit(Task task) {
+        auto& queue = queues[next++ % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+        pending++;
+    }
+
+    // Blocks until every submitted task has run
+    void Run() {
+        std::vector<std::thread> workers;
+        for (std::size_t id = 1; id < queues.size(); id++)
+            workers.emplace_back(&ThreadPool::Work, this, id);
+        Work(0);
+        for (auto& worker: workers) worker.join();
+    }
+
+    std::size_t Size() const { return queues.size(); }
+
+private:
+    struct Queue {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue>       queues;
+    std::size_t              next    = 0;
+    std::atomic<std::size_t> pending = 0;
+
+    bool Pop(std::size_t id, Task& task) {
+        auto& own = queues[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.tasks.empty()) return false;
+        task = std::move(own.tasks.back()); own.tasks.pop_back();
+        return true;
+    }
+
+    bool Steal(std::size_t id, Task& task) {
+        for (std::size_t i = 1; i < queues.size(); i++) {
+            auto& victim = queues[(id + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front()); victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void Work(std::size_t id) {
+        Task task;
+        while (pending > 0) {
+            if (Pop(id, task) || Steal(id, task))
+                task(), pending--;
+            else std::this_thread::yield();
+        }
+    }
+};
@@ -0,0 +1,142 @@
+#include "Trace.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+constexpr std::uint8_t TRACE_VERSION = 1;
+
+Trace::Trace(std::size_t capacity) {
+    std::size_t size = 1;
+    while (size < capacity) size <<= 1;
+    ring.resize(size);
+    mask = size - 1;
+}
+
+Trace::Target Trace::Overwrites(Opcode op, std::uint8_t X, std::size_t& length) {
+    switch (op) {
+        case Opcode::LD_B_VX:   length = 3;     return Target::MEMORY;
+        case Opcode::LD_MEM_VX: length = X + 1; return Target::MEMORY;
+        case Opcode::LD_VX_MEM: length = X + 1; return Target::REGISTERS;
+        case Opcode::LD_R_VX:   length = X + 1; return Target::FLAGS;
+        case Opcode::LD_VX_R:   length = X + 1; return Target::REGISTERS;
+        default:                length = 0;     return Target::NONE;
+    }
+}
+
+void Trace::Bytes(const Machine& m, const Instruction& in) {
+    std::size_t length;
+    std::uint8_t old[16];
+    switch (Overwrites(in.op, in.X, length)) {
+        case Target::MEMORY:
+            for (std::size_t i = 0; i < length; i++) old[i] = m.memory[(m.I + i) & 0xfff];
+            break;
+        case Target::REGISTERS: std::copy_n(m.V.begin(), length, old);     break;
+        case Target::FLAGS:     std::copy_n(m.flags.begin(), length, old); break;
+        case Target::NONE:      return;
+    }
+    for (std::size_t done = 0; done < length; done += CHUNK) {
+        auto& record = ring[written++ & mask];
+        record = { };
+        record.kind = Kind::BYTES;
+        auto* data  = reinterpret_cast<std::uint8_t*>(&record) + 1;
+        std::copy_n(old + done, std::min(CHUNK, length - done), data);
+    }
+}
+
+void Trace::Tick(const Machine& m) {
+    auto& record = ring[written++ & mask];
+    record = { };
+    record.kind = Kind::TICK;
+    record.SP = m.SP, record.DT = m.DT, record.ST = m.ST;
+    record.PC = m.PC, record.I = m.I;
+}
+
+void Trace::Idle(std::uint64_t count) {
+    for (; count; count -= std::min<std::uint64_t>(count, UINT32_MAX)) {
+        auto& record = ring[written++ & mask];
+        record = { };
+        record.kind  = Kind::IDLE;
+        record.count = std::min<std::uint64_t>(count, UINT32_MAX);
+    }
+}
+
+void Trace::Drop() {
+    if (written) written--;
+    while (written && ring[(written-1) & mask].kind == Kind::BYTES) written--;
+}
+
+void Trace::Save(const std::string& filename, const Chip8& c8, const std::string& fault) const {
+    std::vector<std::uint8_t> out { 'C', '8', 'T', 'R', TRACE_VERSION };
+    auto put = [&out](std::uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) out.push_back(value >> (8*i) & 0xff);
+    };
+
+    std::vector<std::uint8_t> state;
+    c8.SaveState(state);
+    auto count = std::min<std::uint64_t>(written, ring.size());
+    put(c8.GetQuirks(), 1); put(c8.Rom().Hash(), 8);
+    put(std::min<std::size_t>(fault.size(), 255), 1);
+    out.insert(out.end(), fault.begin(), fault.begin() + std::min<std::size_t>(fault.size(), 255));
+    out.insert(out.end(), state.begin(), state.end());
+    put(count, 8);
+    out.reserve(out.size() + count * sizeof(Record));
+    for (auto n = written - count; n < written; n++) {
+        auto& record = ring[n & mask];
+        put(static_cast<std::uint8_t>(record.kind), 1);
+        if (record.kind == Kind::BYTES) { out.insert(out.end(), Data(record), Data(record) + CHUNK); continue; }
+        put(record.SP, 1); put(record.DT, 1); put(record.ST, 1); put(record.vx, 1); put(record.vf, 1);
+        put(record.PC, 2); put(record.OP, 2); put(record.I, 2); put(record.count, 4);
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(out.data()), out.size()))
+        throw std::runtime_error("chip8: Cannot write trace " + filename);
+}
+
+Trace::Dump Trace::Load(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("chip8: Cannot open trace " + filename);
+    std::vector<std::uint8_t> in(std::istreambuf_iterator<char>(file), { });
+
+    auto it = in.cbegin();
+    auto need = [&](std::size_t bytes) {
+        if (static_cast<std::size_t>(in.cend() - it) < bytes)
+            throw std::runtime_error("chip8: Truncated trace " + filename);
+    };
+    auto get = [&](int bytes) {
+        need(bytes);
+        std::uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) value |= std::uint64_t(*it++) << (8*i);
+        return value;
+    };
+
+    need(5);
+    if (std::string(it, it+4) != "C8TR") throw std::runtime_error("chip8: Not a trace " + filename);
+    if (it[4] != TRACE_VERSION) throw std::runtime_error("chip8: Unsupported trace version");
+    it += 5;
+
+    Dump dump;
+    dump.quirks   = get(1);
+    dump.rom_hash = get(8);
+    auto length   = get(1);
+    need(length);
+    dump.fault.assign(it, it + length); it += length;
+    need(Chip8::STATE_SIZE);
+    dump.state.assign(it, it + Chip8::STATE_SIZE); it += Chip8::STATE_SIZE;
+    auto count = get(8);
+    need(count * sizeof(Record));
+    dump.records.resize(count);
+    for (auto& record: dump.records) {
+        record.kind = static_cast<Kind>(get(1));
+        if (record.kind > Kind::IDLE) throw std::runtime_error("chip8: Corrupted trace " + filename);
+        if (record.kind == Kind::BYTES) {
+            std::copy_n(it, CHUNK, reinterpret_cast<std::uint8_t*>(&record) + 1); it += CHUNK;
+            continue;
+        }
+        record.SP = get(1); record.DT = get(1); record.ST = get(1); record.vx = get(1); record.vf = get(1);
+        record.PC = get(2); record.OP = get(2); record.I = get(2); record.count = get(4);
+    }
+    return dump;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Chip8.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Execution trace: every instruction the interpreter runs, in a ring of
+// fixed-size records that keeps the latest `Capacity()` of them. A record
+// holds what its instruction is about to overwrite (PC, I, SP, the timers,
+// VX and VF), so the hot path stores 16 bytes and never looks at what the
+// instruction does; FX33, FX55, FX65, FX75 and FX85, which write more,
+// are preceded by BYTES records of the memory, registers or flags they
+// overwrite, 15 bytes each. Timer ticks and skipped idle turns
+// (Chip8::EnableIdleSkip) get records of their own. Saved with the machine
+// state it ended on, the ring is enough to walk back to the state before
+// each record (chip8-trace). Resets and loaded states start it over: the
+// records before them do not lead to the machine after them.
+class Trace final {
+public:
+    enum class Kind : std::uint8_t { STEP, BYTES, TICK, IDLE };
+
+    struct Record {
+        Kind          kind = Kind::STEP;
+        std::uint8_t  SP = 0, DT = 0, ST = 0;  // Before the instruction, or the TICK
+        std::uint8_t  vx = 0, vf = 0;          // Before: VX of the instruction's X, VF
+        std::uint16_t PC = 0, OP = 0, I = 0;   // Before
+        std::uint32_t count = 0;               // IDLE: instructions skipped
+    };
+    static_assert(sizeof(Record) == 16, "Records are written with two stores");
+
+    // BYTES records keep their bytes where the fields after `kind` are
+    static constexpr std::size_t CHUNK = sizeof(Record) - 1;
+    static const std::uint8_t* Data(const Record& record) {
+        return reinterpret_cast<const std::uint8_t*>(&record) + 1;
+    }
+
+    static constexpr std::size_t DEFAULT_CAPACITY = 1 << 20; // 16MB
+
+    explicit Trace(std::size_t capacity = DEFAULT_CAPACITY); // Rounded up to a power of 2
+
+    std::size_t   Capacity() const { return ring.size(); }
+    std::uint64_t Written()  const { return written; }  // Records, since the last Clear()
+    void Clear() { written = 0; }
+
+    // Recorded by Chip8, before each instruction executes
+    inline void Step(const Machine& m, const Instruction& in) {
+        if ((in.op >= Opcode::LD_B_VX && in.op <= Opcode::LD_VX_MEM) ||
+            in.op == Opcode::LD_R_VX || in.op == Opcode::LD_VX_R) Bytes(m, in);
+        ring[written++ & mask] = {Kind::STEP, m.SP, m.DT, m.ST, m.V[in.X], m.V[0xf], m.PC, in.OP, m.I, 0};
+    }
+    void Tick(const Machine& m);
+    void Idle(std::uint64_t count);
+    void Drop(); // The last instruction trapped instead of executing
+
+    // Little endian: "C8TR", version, quirks, ROM hash, the fault that ended
+    // it (empty if none), the machine state at the end (Chip8::SaveState) and
+    // the records, oldest first, as laid out above.
+    void Save(const std::string& filename, const Chip8& c8, const std::string& fault = "") const;
+
+    // A saved trace, from the oldest record to the state it ended on
+    struct Dump {
+        std::uint8_t              quirks   = Quirks::DEFAULT;
+        std::uint64_t             rom_hash = 0;
+        std::string               fault;
+        std::vector<std::uint8_t> state;   // Chip8::SaveState() at the end
+        std::vector<Record>       records;
+    };
+    static Dump Load(const std::string& filename);
+
+    // What an instruction writes beyond its STEP record, `length` bytes
+    // of: memory from I, registers from V0, or flags from the first one
+    enum class Target : std::uint8_t { NONE, MEMORY, REGISTERS, FLAGS };
+    static Target Overwrites(Opcode op, std::uint8_t X, std::size_t& length);
+
+private:
+    std::vector<Record> ring;
+    std::size_t         mask    = 0;
+    std::uint64_t       written = 0;
+
+    void Bytes(const Machine& m, const Instruction& in);
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer, single consumer handoff of the latest value.
+// The producer fills Back() and publishes it, the consumer always reads the
+// newest published value; neither side ever waits for the other, values the
+// consumer was too slow to see are simply overwritten.
+template <typename T>
+class TripleBuffer final {
+public:
+    // Producer
+    T&   Back() { return slots[back].value; }
+    void Publish() { back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX; }
+
+    // Consumer, the same value again when nothing new was published
+    const T& Front() {
+        if (middle.load(std::memory_order_relaxed) & FRESH)
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return slots[front].value;
+    }
+
+private:
+    static constexpr std::uint8_t INDEX = 0x3, FRESH = 0x4;
+
+    struct alignas(64) Slot { T value { }; };
+    std::array<Slot, 3> slots;
+
+    alignas(64) std::atomic<std::uint8_t> middle { 1 }; // Slot index, FRESH once published
+    alignas(64) std::uint8_t back  = 0;                  // Producer only
+    alignas(64) std::uint8_t front = 2;                  // Consumer only
+};
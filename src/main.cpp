@@ -1,37 +1,98 @@
+#include "AnsiDisplay.hpp"
+#include "Breakpoints.hpp"
 #include "Chip8.hpp"
 #include "Display.hpp"
 #include "Disassembler.hpp"
+#include "Emulator.hpp"
+#include "FrameExport.hpp"
+#include "InputLog.hpp"
+#include "Scheduler.hpp"
+#include "Trace.hpp"
 
+#include <memory>
+#include <random>
+#include <thread>
 #include <iostream>
-#include <chrono>
 #include <stdexcept>
 #include <unistd.h>
 
-using ms =  std::chrono::duration<float, std::chrono::milliseconds::period>;
-using hr_clock = std::chrono::high_resolution_clock;
-
+//     chip8 [--seed n] [--record file] [--jit] [--hold ticks] [--quirks q]
+//           [--trace records] [--script file] [--ansi] [--shm name]
+//           [--pbm file | --pgm file] rom
 int main(int argc, char* argv[]) {
 
-    if (argc < 2) throw std::runtime_error("chip8: no input file");
+    std::string rom, record, script, quirks = "auto";
+    FrameExport output;
+    bool jit = false, ansi = false;
+    int hold = Keyboard::HOLD;
+    std::size_t trace_records = 0;
+    std::uint64_t seed = std::random_device{}();
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() {
+            if (i+1 >= argc) throw std::runtime_error("chip8: missing value for " + arg);
+            return std::string(argv[++i]);
+        };
+        if      (arg == "--seed")   seed   = std::stoull(value());
+        else if (arg == "--record") record = value();
+        else if (arg == "--jit")    jit    = true;
+        else if (arg == "--ansi")   ansi   = true;
+        else if (arg == "--hold")   hold   = std::stoi(value());
+        else if (arg == "--quirks") quirks = value();
+        else if (arg == "--trace")  trace_records = std::stoull(value());
+        else if (arg == "--script") script = value();
+        else if (arg == "--shm")    output.Share(value());
+        else if (arg == "--pbm" || arg == "--pgm") {
+            auto path = value(); // Not stdout, the TUI draws there
+            if (path == "-") throw std::runtime_error("chip8: " + arg + " needs a file or FIFO");
+            output.Stream(path, arg == "--pbm" ? FrameExport::Format::PBM : FrameExport::Format::PGM);
+        }
+        else rom = arg;
+    }
+    if (rom.empty()) throw std::runtime_error("chip8: no input file");
 
-    Chip8   chip8(argv[1]);
-    Display display(chip8);
+    auto image = RomImage::Load(rom);
+    Chip8 chip8(image);
+    chip8.Seed(seed);
+    chip8.EnableJit(jit);
+    chip8.EnableIdleSkip(true); // Exact, and spares the host the wait loops
+    chip8.SetKeyHold(hold);
+    chip8.SetQuirks(quirks == "auto" ? Quirks::Detect(*image) : Quirks::Parse(quirks));
 
-    auto last_tick_cpu   = hr_clock::now();
-    auto last_tick_timer = hr_clock::now();
+    InputLog log;
+    if (!record.empty()) {
+        log.rom_hash = image->Hash();
+        log.seed     = seed;
+        log.hold     = hold;
+        log.quirks   = chip8.GetQuirks();
+        chip8.input_log = &log;
+    }
 
-    while (!chip8.quit) {
-        auto tick = hr_clock::now();
+    // Written to <rom>.trace on F6 and when the core traps
+    std::unique_ptr<Trace> trace;
+    if (trace_records) trace = std::make_unique<Trace>(trace_records), chip8.trace = trace.get();
 
-        float delta_cpu   = ms(tick - last_tick_cpu  ).count();
-        float delta_timer = ms(tick - last_tick_timer).count();
+    // From the script and the b and n keys; none armed, none checked
+    Breakpoints breakpoints;
+    if (!script.empty()) breakpoints.Load(script);
+    chip8.breakpoints = &breakpoints;
 
-        if (delta_cpu > 1/chip8.cycle_speed*1000) // 150Hz default
-            chip8.Cycle(), display.Refresh(), last_tick_cpu = tick;
+    // The core paces itself on its own thread, the terminal gets whatever
+    // frame is newest each time it is ready for one
+    Emulator emulator(chip8, output.Enabled() ? &output : nullptr);
+    auto show = [&emulator](auto&& display) {
+        while (emulator.Running()) {
+            display.Refresh();
+            std::this_thread::sleep_for(std::chrono::microseconds(1000000 / FRAME_RATE));
+        }
+    };
+    if (ansi) show(AnsiDisplay(emulator));
+    else      show(Display(emulator));
+    emulator.Join();
 
-        if (delta_timer > 1/60.f*1000) // 60Hz
-            chip8.UpdateTimers(), last_tick_timer = tick;
-    }
+    if (!record.empty()) log.Save(record);
+
+    PROFILE(chip8.profile.Dump("chip8-profile.json");)
 
     return 0;
 }
@@ -0,0 +1,35 @@
+#include "../Disassembler.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// ROMs too short for a whole instruction, or ending on half of one: the
+// walk must not read or mark past their last byte (run under `make debug`
+// flags to have ASan check it too).
+
+static int failures = 0;
+
+static void Expect(bool ok, const std::string& what) {
+    if (!ok) std::printf("FAIL disassembler: %s\n", what.c_str()), failures++;
+}
+
+static std::vector<Disassembler::Line> Lines(std::vector<std::uint8_t> bytes) {
+    return Disassembler::Disassemble(*RomImage::FromBytes("test", std::move(bytes)));
+}
+
+int main() {
+    Expect(Lines({ }).empty(), "empty ROM has no lines");
+
+    auto one = Lines({0x12});
+    Expect(one.size() == 1 && !one[0].code() && one[0].size == 1, "1-byte ROM is one data byte");
+
+    auto odd = Lines({0x12, 0x00, 0x60}); // jp $200, then half of an instruction
+    Expect(odd.size() == 2 && odd[0].op == Opcode::JP && odd[1].size == 1 && !odd[1].code(),
+           "odd-length ROM ends on a data byte");
+
+    auto fall = Lines({0x60, 0x01, 0x61}); // Falls through into the last byte
+    Expect(fall.size() == 2 && fall[0].code() && !fall[1].code(), "fall-through stops at the last whole word");
+
+    return failures != 0;
+}
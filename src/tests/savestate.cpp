@@ -0,0 +1,40 @@
+#include "../Chip8.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// A state saved in 64x32 mode, loaded into a machine in SUPER-CHIP's 128x64
+// mode: switching the quirks and the mode over must not blank the screen
+// that came with the state.
+
+static int failures = 0;
+
+static void Expect(bool ok, const std::string& what) {
+    if (!ok) std::printf("FAIL savestate: %s\n", what.c_str()), failures++;
+}
+
+static std::shared_ptr<const RomImage> Rom(std::vector<std::uint8_t> bytes) {
+    return RomImage::FromBytes("test", std::move(bytes));
+}
+
+int main() {
+    // ld v0,5 / ld F,v0 / drw v0,v0,5 / jp $206
+    Chip8 low(Rom({0x60, 0x05, 0xf0, 0x29, 0xd0, 0x05, 0x12, 0x06}));
+    low.Run(4);
+    std::vector<std::uint8_t> state;
+    low.SaveState(state);
+
+    // high / jp $202
+    Chip8 high(Rom({0x00, 0xff, 0x12, 0x02}));
+    high.SetQuirks(Quirks::SUPERCHIP);
+    high.Run(2);
+    Expect(high.State().hires, "SUPER-CHIP machine is in 128x64 mode");
+
+    high.LoadState(state);
+    Expect(!high.State().hires, "loaded state is in 64x32 mode");
+    Expect(high.GetQuirks() == Quirks::DEFAULT, "loaded state brings its quirks");
+    Expect(high.FrameHash() == low.FrameHash(), "loaded screen is the saved one");
+
+    return failures != 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+// Command line ROM arguments: files are kept, directories are replaced by
+// the regular files they contain, in sorted order.
+inline void ExpandRoms(const std::string& arg, std::vector<std::string>& roms) {
+    if (!std::filesystem::is_directory(arg)) return roms.push_back(arg);
+
+    std::vector<std::string> files;
+    for (auto& entry: std::filesystem::directory_iterator(arg))
+        if (entry.is_regular_file()) files.push_back(entry.path().string());
+    std::sort(files.begin(), files.end());
+    roms.insert(roms.end(), files.begin(), files.end());
+}
@@ -0,0 +1,137 @@
+#include "../Chip8.hpp"
+#include "../Lockstep.hpp"
+#include "../ThreadPool.hpp"
+#include "Roms.hpp"
+
+#include <set>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+// Headless batch runner: many independent Chip8 instances spread over a
+// work-stealing pool, reporting throughput and a final framebuffer hash.
+// With -L the instances of a ROM run as lanes of lockstep engines instead.
+//
+//     chip8-batch [-c cycles] [-j threads] [-n instances] [-f per_tick] [-J] [-I] [-L lanes] rom|dir...
+
+using steady_clock = std::chrono::steady_clock;
+
+struct Options {
+    std::uint64_t            cycles    = 1000000; // Per instance
+    std::size_t              threads   = std::thread::hardware_concurrency();
+    std::size_t              instances = 1;       // Per ROM
+    std::uint64_t            per_tick  = 10;      // Instructions per 60Hz tick
+    bool                     jit       = false;   // Recompiler instead of the interpreter
+    bool                     idle      = false;   // Skip idle loops
+    std::size_t              lanes     = 0;       // Per lockstep engine, 0 for scalar machines
+    std::vector<std::string> roms;
+};
+
+struct Result {
+    std::uint64_t hash   = 0;
+    bool          failed = false;
+    std::uint64_t idle   = 0; // Instructions skipped in idle loops
+};
+
+static Options ParseArgs(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() {
+            if (i+1 >= argc) throw std::runtime_error("chip8-batch: missing value for " + arg);
+            return std::stoull(argv[++i]);
+        };
+        if      (arg == "-c") opt.cycles    = value();
+        else if (arg == "-j") opt.threads   = value();
+        else if (arg == "-n") opt.instances = value();
+        else if (arg == "-f") opt.per_tick  = std::max<std::uint64_t>(1, value());
+        else if (arg == "-J") opt.jit       = true;
+        else if (arg == "-I") opt.idle      = true;
+        else if (arg == "-L") opt.lanes     = value();
+        else ExpandRoms(arg, opt.roms);
+    }
+    if (opt.roms.empty()) throw std::runtime_error("chip8-batch: no input file");
+    if (opt.instances == 0) throw std::runtime_error("chip8-batch: -n must be at least 1");
+    if ((opt.jit || opt.idle) && opt.lanes) throw std::runtime_error("chip8-batch: -J and -I are for scalar machines, not -L");
+    return opt;
+}
+
+int main(int argc, char* argv[]) {
+    auto opt = ParseArgs(argc, argv);
+
+    // Every instance of a ROM shares one image, loaded once
+    std::vector<std::shared_ptr<const RomImage>> images(opt.roms.size());
+    for (std::size_t rom = 0; rom < opt.roms.size(); rom++)
+        try { images[rom] = RomImage::Load(opt.roms[rom]); } catch (const std::exception&) { }
+
+    std::vector<Result> results(opt.roms.size() * opt.instances);
+    ThreadPool pool(opt.threads);
+
+    // Lockstep: one task per engine, lane i is instance `first + i`
+    auto lockstep = [&](std::size_t rom, std::size_t first, std::size_t lanes) {
+        auto result = results.begin() + rom*opt.instances + first;
+        if (!images[rom]) return std::fill_n(result, lanes, Result{0, true}), void();
+        Lockstep engine(images[rom], lanes);
+        for (std::size_t lane = 0; lane < lanes; lane++) engine.Seed(lane, first + lane);
+        for (std::uint64_t done = 0; done < opt.cycles; done += opt.per_tick) {
+            engine.Run(std::min(opt.per_tick, opt.cycles - done));
+            engine.UpdateTimers();
+        }
+        for (std::size_t lane = 0; lane < lanes; lane++)
+            result[lane] = {engine.FrameHash(lane), engine.Faulted(lane)};
+    };
+
+    for (std::size_t rom = 0; rom < opt.roms.size(); rom++)
+        for (std::size_t n = 0; opt.lanes && n < opt.instances; n += opt.lanes)
+            pool.Submit([&, rom, n]() { lockstep(rom, n, std::min(opt.lanes, opt.instances - n)); });
+
+    for (std::size_t rom = 0; rom < opt.roms.size(); rom++)
+        for (std::size_t n = 0; !opt.lanes && n < opt.instances; n++)
+            pool.Submit([&, rom, n]() {
+                auto& result = results[rom*opt.instances + n];
+                if (!images[rom]) return void(result.failed = true);
+                try {
+                    Chip8 chip8(images[rom]);
+                    chip8.EnableCache(true);
+                    chip8.EnableJit(opt.jit);
+                    chip8.EnableIdleSkip(opt.idle);
+                    chip8.Seed(n); // Instances of a ROM draw different numbers
+                    for (std::uint64_t done = 0; done < opt.cycles; done += opt.per_tick) {
+                        chip8.Run(std::min(opt.per_tick, opt.cycles - done));
+                        chip8.UpdateTimers();
+                    }
+                    result.hash = chip8.FrameHash();
+                    result.idle = chip8.idle_cycles;
+                } catch (const std::exception&) { result.failed = true; }
+            });
+
+    auto start = steady_clock::now();
+    pool.Run();
+    double seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    std::uint64_t total = 0, idle = 0;
+    std::printf("%-40s %9s %16s %s\n", "ROM", "INSTANCES", "FRAMEBUFFER", "DISTINCT");
+    for (std::size_t rom = 0; rom < opt.roms.size(); rom++) {
+        auto first = results.begin() + rom*opt.instances;
+        if (std::any_of(first, first + opt.instances, [](auto& r) { return r.failed; })) {
+            std::printf("%-40s %9zu %16s\n", opt.roms[rom].c_str(), opt.instances, "failed");
+            continue;
+        }
+        std::set<std::uint64_t> distinct;
+        for (auto it = first; it != first + opt.instances; ++it) distinct.insert(it->hash);
+        std::printf("%-40s %9zu %016llx %zu\n", opt.roms[rom].c_str(), opt.instances,
+                    static_cast<unsigned long long>(first->hash), distinct.size());
+        total += opt.cycles * opt.instances;
+        for (auto it = first; it != first + opt.instances; ++it) idle += it->idle;
+    }
+
+    std::printf("\n%zu instances, %llu instructions in %.3fs on %zu threads: %.1f M instr/s\n",
+                results.size(), static_cast<unsigned long long>(total), seconds,
+                pool.Size(), total / seconds / 1e6);
+    if (opt.idle) std::printf("%llu of them skipped in idle loops (%.1f%%)\n",
+                              static_cast<unsigned long long>(idle), total ? 100.0 * idle / total : 0.0);
+    return 0;
+}
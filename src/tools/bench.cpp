@@ -0,0 +1,217 @@
+#include "../Chip8.hpp"
+#include "Roms.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+// Benchmark harness: every ROM runs headless for a fixed instruction count,
+// then one synthetic kernel per opcode class measures what each class costs.
+// Results go to stdout and, as JSON, to the output file.
+//
+//     chip8-bench [-c cycles] [-r repeats] [-f per_tick] [-l label] [-o file] [-J] rom|dir...
+
+using steady_clock = std::chrono::steady_clock;
+
+enum OpClass { ALU, BRANCH, DRAW, MEMORY, OTHER, CLASS_COUNT };
+
+constexpr const char* ClassName[CLASS_COUNT] = { "alu", "branch", "dxyn", "fx33_fx55_fx65", "other" };
+
+constexpr OpClass ClassOf(Opcode op) {
+    switch (op) {
+        case Opcode::LD_VX_NN: case Opcode::ADD_VX_NN: case Opcode::LD_VX_VY:
+        case Opcode::OR:       case Opcode::AND:       case Opcode::XOR:
+        case Opcode::ADD_VX_VY:case Opcode::SUB:       case Opcode::SHR:
+        case Opcode::SUBN:     case Opcode::SHL:       case Opcode::LD_I:
+        case Opcode::RND:      case Opcode::ADD_I_VX:  case Opcode::LD_F_VX:
+            return ALU;
+        case Opcode::JP:       case Opcode::CALL:      case Opcode::RET:
+        case Opcode::SE_VX_NN: case Opcode::SNE_VX_NN: case Opcode::SE_VX_VY:
+        case Opcode::SNE_VX_VY:case Opcode::JP_V0:     case Opcode::SKP:
+        case Opcode::SKNP:
+            return BRANCH;
+        case Opcode::DRW:
+            return DRAW;
+        case Opcode::LD_B_VX:  case Opcode::LD_MEM_VX: case Opcode::LD_VX_MEM:
+            return MEMORY;
+        default:
+            return OTHER;
+    }
+}
+
+struct Options {
+    std::uint64_t            cycles   = 5000000; // Per ROM
+    std::uint64_t            repeats  = 3;       // Best of
+    std::uint64_t            per_tick = 100;     // Instructions per 60Hz tick
+    std::string              label    = "";      // Commit, branch...
+    std::string              output   = "bench.json";
+    bool                     jit      = false;   // Recompiler instead of the interpreter
+    std::vector<std::string> roms;
+};
+
+struct RomResult {
+    std::string   rom;
+    double        seconds = 0;
+    std::uint64_t mix[CLASS_COUNT] = { };
+};
+
+static Options ParseArgs(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() {
+            if (i+1 >= argc) throw std::runtime_error("chip8-bench: missing value for " + arg);
+            return std::string(argv[++i]);
+        };
+        if      (arg == "-c") opt.cycles   = std::stoull(value());
+        else if (arg == "-r") opt.repeats  = std::max<std::uint64_t>(1, std::stoull(value()));
+        else if (arg == "-f") opt.per_tick = std::max<std::uint64_t>(1, std::stoull(value()));
+        else if (arg == "-l") opt.label    = value();
+        else if (arg == "-o") opt.output   = value();
+        else if (arg == "-J") opt.jit      = true;
+        else ExpandRoms(arg, opt.roms);
+    }
+    if (opt.roms.empty()) throw std::runtime_error("chip8-bench: no input file");
+    return opt;
+}
+
+// Best wall time out of `repeats` runs of `cycles` instructions
+static double Time(const std::shared_ptr<const RomImage>& rom, const Options& opt) {
+    double best = 0;
+    for (std::uint64_t r = 0; r < opt.repeats; r++) {
+        Chip8 chip8(rom);
+        chip8.EnableCache(true);
+        chip8.EnableJit(opt.jit);
+        auto start = steady_clock::now();
+        for (std::uint64_t done = 0; done < opt.cycles; done += opt.per_tick) {
+            chip8.Run(std::min(opt.per_tick, opt.cycles - done));
+            chip8.UpdateTimers();
+        }
+        double seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+        if (r == 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+// Same run one instruction at a time, untimed, to count the opcode classes
+static void Mix(const std::shared_ptr<const RomImage>& rom, const Options& opt, std::uint64_t* mix) {
+    Chip8 chip8(rom);
+    for (std::uint64_t done = 0; done < opt.cycles; done++) {
+        mix[ClassOf(Decode(chip8.Fetch()))]++;
+        chip8.Run(1);
+        if ((done+1) % opt.per_tick == 0) chip8.UpdateTimers();
+    }
+}
+
+// One synthetic ROM per class: a setup, then a body of the class's
+// instructions repeated up to 0xe00, then a jump back to the body.
+static std::vector<std::uint8_t> Kernel(OpClass cls) {
+    std::vector<std::uint16_t> setup, body;
+    switch (cls) {
+        case ALU:    setup = {0x6003, 0x6105};
+                     body  = {0x7201, 0x8014, 0x8121, 0x8306, 0x8235, 0xa300, 0xf01e, 0x840e}; break;
+        case BRANCH: setup = {0x6003, 0x6105};
+                     body  = {0x3004, 0x4003, 0x5010, 0x9000};                                 break;
+        case DRAW:   setup = {0x6003, 0x6105, 0xa050};
+                     body  = {0xd015, 0xd105};                                                 break;
+        case MEMORY: setup = {0x6003, 0x6105, 0xa000};
+                     body  = {0xf333, 0xf355, 0xf365};                                         break;
+        default:     setup = {0x6003};
+                     body  = {0xf007, 0xf015, 0xf018, 0xf029};                                 break;
+    }
+    std::vector<std::uint16_t> words = setup;
+    std::uint16_t loop = ENTRY_POINT + setup.size()*2;
+    while (ENTRY_POINT + (words.size() + body.size() + 1)*2 <= 0xe00)
+        words.insert(words.end(), body.begin(), body.end());
+    words.push_back(0x1000 | loop);
+
+    std::vector<std::uint8_t> bytes;
+    for (auto word: words) bytes.push_back(word >> 8), bytes.push_back(word & 0xff);
+    return bytes;
+}
+
+static double KernelCost(OpClass cls, const Options& opt) {
+    auto kernel = RomImage::FromBytes(ClassName[cls], Kernel(cls));
+    return Time(kernel, opt) / opt.cycles * 1e9;
+}
+
+// A JSON string literal: quotes, backslashes and control characters escaped
+static std::string Quote(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c: text) {
+        char escape[8];
+        if (c == '"' || c == '\\') out += '\\', out += c;
+        else if (c < 0x20) std::snprintf(escape, sizeof escape, "\\u%04x", c), out += escape;
+        else out += c;
+    }
+    return out + '"';
+}
+
+int main(int argc, char* argv[]) {
+    auto opt = ParseArgs(argc, argv);
+
+    std::vector<RomResult> results;
+    double total_seconds = 0;
+
+    std::printf("%-40s %10s %8s", "ROM", "M INSTR/S", "NS/INSTR");
+    for (auto name: ClassName) std::printf(" %7.7s%%", name);
+    std::printf("\n");
+
+    for (auto& rom: opt.roms) {
+        RomResult result { rom };
+        try {
+            auto image = RomImage::Load(rom);
+            result.seconds = Time(image, opt);
+            Mix(image, opt, result.mix);
+        } catch (const std::exception& e) {
+            std::printf("%-40s %s\n", rom.c_str(), e.what());
+            continue;
+        }
+        total_seconds += result.seconds;
+        std::printf("%-40s %10.1f %8.2f", rom.c_str(),
+                    opt.cycles / result.seconds / 1e6, result.seconds / opt.cycles * 1e9);
+        for (auto count: result.mix) std::printf(" %7.1f%%", 100.0 * count / opt.cycles);
+        std::printf("\n");
+        results.push_back(result);
+    }
+
+    if (results.empty()) throw std::runtime_error("chip8-bench: No ROM could be run");
+
+    double cost[CLASS_COUNT];
+    std::printf("\n%-40s %8s\n", "CLASS", "NS/INSTR");
+    for (int cls = 0; cls < CLASS_COUNT; cls++) {
+        cost[cls] = KernelCost(static_cast<OpClass>(cls), opt);
+        std::printf("%-40s %8.2f\n", ClassName[cls], cost[cls]);
+    }
+
+    auto total = opt.cycles * results.size();
+    std::printf("\n%zu ROMs, %.1f M instr/s, %.2f ns/instr\n",
+                results.size(), total / total_seconds / 1e6, total_seconds / total * 1e9);
+
+    std::ofstream json(opt.output);
+    if (!json) throw std::runtime_error("chip8-bench: Failed to open " + opt.output);
+    json << "{\n  \"label\": " << Quote(opt.label) << ",\n"
+         << "  \"engine\": \"" << (opt.jit ? "jit" : "interpreter") << "\",\n"
+         << "  \"cycles\": " << opt.cycles << ",\n"
+         << "  \"instr_per_sec\": " << total / total_seconds << ",\n"
+         << "  \"ns_per_instr\": " << total_seconds / total * 1e9 << ",\n"
+         << "  \"class_ns_per_instr\": {";
+    for (int cls = 0; cls < CLASS_COUNT; cls++)
+        json << (cls ? ", " : " ") << "\"" << ClassName[cls] << "\": " << cost[cls];
+    json << " },\n  \"roms\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        json << "    { \"rom\": " << Quote(r.rom) << ", "
+             << "\"instr_per_sec\": " << opt.cycles / r.seconds << ", "
+             << "\"ns_per_instr\": " << r.seconds / opt.cycles * 1e9 << ", \"mix\": {";
+        for (int cls = 0; cls < CLASS_COUNT; cls++)
+            json << (cls ? ", " : " ") << "\"" << ClassName[cls] << "\": " << r.mix[cls];
+        json << " } }" << (i+1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "../Disassembler.hpp"
+#include "../ThreadPool.hpp"
+#include "Roms.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <filesystem>
+
+// Standalone disassembler: every ROM is disassembled on its own task, the
+// listings are printed in argument order or written next to each other.
+//
+//     chip8-dis [-j threads] [-o dir] rom|dir...
+
+using steady_clock = std::chrono::steady_clock;
+
+struct Options {
+    std::size_t              threads = std::thread::hardware_concurrency();
+    std::string              output;  // One .asm per ROM in this directory, stdout if empty
+    std::vector<std::string> roms;
+};
+
+struct Listing {
+    std::string   text;
+    std::size_t   code   = 0; // Bytes decoded as instructions
+    std::size_t   data   = 0;
+    bool          failed = false;
+};
+
+static Options ParseArgs(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() {
+            if (i+1 >= argc) throw std::runtime_error("chip8-dis: missing value for " + arg);
+            return std::string(argv[++i]);
+        };
+        if      (arg == "-j") opt.threads = std::stoull(value());
+        else if (arg == "-o") opt.output  = value();
+        else ExpandRoms(arg, opt.roms);
+    }
+    if (opt.roms.empty()) throw std::runtime_error("chip8-dis: no input file");
+    return opt;
+}
+
+// "0200  6a02  ld   va,$02", data lines leave the word column blank
+static void Print(const std::vector<Disassembler::Line>& lines, Listing& listing) {
+    char text[32], buffer[64];
+    listing.text.reserve(lines.size() * 32);
+    for (auto& line: lines) {
+        Disassembler::Format(line, text);
+        auto length = line.code()
+            ? std::snprintf(buffer, sizeof buffer, "%04x  %04x  %s\n", line.address, line.OP, text)
+            : std::snprintf(buffer, sizeof buffer, "%04x        %s\n", line.address, text);
+        listing.text.append(buffer, length);
+        (line.code() ? listing.code : listing.data) += line.size;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    auto opt = ParseArgs(argc, argv);
+    if (!opt.output.empty()) std::filesystem::create_directories(opt.output);
+
+    std::vector<Listing> listings(opt.roms.size());
+    ThreadPool pool(opt.threads);
+
+    for (std::size_t rom = 0; rom < opt.roms.size(); rom++)
+        pool.Submit([&, rom]() {
+            auto& listing = listings[rom];
+            try {
+                Print(Disassembler::Disassemble(*RomImage::Load(opt.roms[rom])), listing);
+                if (opt.output.empty()) return;
+                auto path = std::filesystem::path(opt.output) /
+                            std::filesystem::path(opt.roms[rom]).filename().concat(".asm");
+                std::ofstream(path, std::ios::binary) << listing.text;
+                listing.text.clear();
+            } catch (const std::exception&) { listing.failed = true; }
+        });
+
+    auto start = steady_clock::now();
+    pool.Run();
+    double seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    std::size_t code = 0, data = 0, failed = 0;
+    for (std::size_t rom = 0; rom < opt.roms.size(); rom++) {
+        auto& listing = listings[rom];
+        if (listing.failed) {
+            std::fprintf(stderr, "chip8-dis: cannot disassemble %s\n", opt.roms[rom].c_str());
+            failed++;
+            continue;
+        }
+        if (opt.output.empty())
+            std::printf("; %s\n%s\n", opt.roms[rom].c_str(), listing.text.c_str());
+        code += listing.code, data += listing.data;
+    }
+
+    std::fprintf(stderr, "%zu ROMs, %zu code bytes, %zu data bytes in %.3fs on %zu threads\n",
+                 opt.roms.size() - failed, code, data, seconds, pool.Size());
+    return failed ? 1 : 0;
+}
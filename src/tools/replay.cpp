@@ -0,0 +1,122 @@
+#include "../Chip8.hpp"
+#include "../FrameExport.hpp"
+#include "../InputLog.hpp"
+#include "../Trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Headless replay of a session recorded with `chip8 --record`: re-runs the
+// ROM through the same inputs, checks the recorded framebuffer hashes and
+// prints its own every `every` frames, then times the whole replay. The
+// first run can export its frames like `chip8 --shm/--pbm/--pgm` does, and
+// trace its last instructions into `file` (see Trace.hpp), written when it
+// ends, diverges or traps.
+//
+//     chip8-replay [-e every] [-r repeats] [-J] [-I] [-t file] [-s name] [-p file | -g file] rom log
+
+using steady_clock = std::chrono::steady_clock;
+
+struct Options {
+    std::uint64_t every   = 60; // Frames between printed hashes, 0 for none
+    std::uint64_t repeats = 1;  // Timed runs, the fastest is reported
+    bool          jit     = false;
+    bool          idle    = false; // Skip idle loops
+    std::string   trace;   // Execution trace of the first run, none if empty
+    std::string   shm;
+    std::string   stream;  // "-" for stdout
+    FrameExport::Format format = FrameExport::Format::PBM;
+    std::string   rom;
+    std::string   log;
+};
+
+static Options ParseArgs(int argc, char* argv[]) {
+    Options opt;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto text = [&]() {
+            if (i+1 >= argc) throw std::runtime_error("chip8-replay: missing value for " + arg);
+            return std::string(argv[++i]);
+        };
+        auto value = [&]() { return std::stoull(text()); };
+        if      (arg == "-e") opt.every   = value();
+        else if (arg == "-r") opt.repeats = std::max<std::uint64_t>(1, value());
+        else if (arg == "-J") opt.jit     = true;
+        else if (arg == "-I") opt.idle    = true;
+        else if (arg == "-t") opt.trace   = text();
+        else if (arg == "-s") opt.shm     = text();
+        else if (arg == "-p") opt.stream  = text(), opt.format = FrameExport::Format::PBM;
+        else if (arg == "-g") opt.stream  = text(), opt.format = FrameExport::Format::PGM;
+        else files.push_back(arg);
+    }
+    if (files.size() != 2) throw std::runtime_error("chip8-replay: expected a ROM and an input log");
+    opt.rom = files[0], opt.log = files[1];
+    return opt;
+}
+
+int main(int argc, char* argv[]) {
+    auto opt   = ParseArgs(argc, argv);
+    auto image = RomImage::Load(opt.rom);
+    auto log   = InputLog::Load(opt.log);
+    if (image->Hash() != log.rom_hash)
+        throw std::runtime_error("chip8-replay: " + opt.log + " was not recorded on " + opt.rom);
+
+    FrameExport output;
+    if (!opt.shm.empty())    output.Share(opt.shm);
+    if (!opt.stream.empty()) output.Stream(opt.stream, opt.format);
+    if (opt.stream == "-") opt.every = 0;
+
+    double best = 0;
+    std::uint64_t cycles = 0, checked = 0, idle = 0;
+    for (std::uint64_t run = 0; run < opt.repeats; run++) {
+        Chip8 chip8(image);
+        chip8.EnableCache(true);
+        chip8.EnableJit(opt.jit);
+        chip8.EnableIdleSkip(opt.idle);
+        std::unique_ptr<Trace> trace;
+        if (!opt.trace.empty() && run == 0) trace = std::make_unique<Trace>(), chip8.trace = trace.get();
+
+        std::uint64_t frames = 0;
+        auto applied = [&](const InputLog::Event& event) {
+            if (run != 0) return;
+            if (event.type == InputLog::Type::HASH) checked++;
+            if (event.type != InputLog::Type::TIMER) return;
+            if (output.Enabled()) output.Publish(chip8);
+            if (!opt.every || ++frames % opt.every) return;
+            std::printf("%8llu %12llu %016llx\n", static_cast<unsigned long long>(frames),
+                        static_cast<unsigned long long>(chip8.cycles),
+                        static_cast<unsigned long long>(chip8.FrameHash()));
+        };
+
+        auto start = steady_clock::now();
+        bool exact;
+        try { exact = log.Replay(chip8, applied); }
+        catch (const std::runtime_error& trap) {
+            if (trace) trace->Save(opt.trace, chip8, trap.what());
+            throw;
+        }
+        double seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+        if (trace) trace->Save(opt.trace, chip8, exact ? "" : "chip8: Framebuffer diverged");
+
+        if (!exact) {
+            std::fprintf(stderr, "chip8-replay: framebuffer diverged at cycle %llu\n",
+                         static_cast<unsigned long long>(chip8.cycles));
+            return 1;
+        }
+        cycles = chip8.cycles, idle = chip8.idle_cycles;
+        best = run == 0 ? seconds : std::min(best, seconds);
+    }
+
+    auto* summary = opt.stream == "-" ? stderr : stdout; // Frames own stdout
+    std::fprintf(summary, "\n%zu events, %llu hashes matched, %llu instructions in %.3fs: %.1f M instr/s\n",
+                 log.events.size(), static_cast<unsigned long long>(checked),
+                 static_cast<unsigned long long>(cycles), best, cycles / best / 1e6);
+    if (opt.idle) std::fprintf(summary, "%llu of them skipped in idle loops (%.1f%%)\n",
+                               static_cast<unsigned long long>(idle), cycles ? 100.0 * idle / cycles : 0.0);
+    return 0;
+}
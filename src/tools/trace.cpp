@@ -0,0 +1,193 @@
+#include "../Chip8.hpp"
+#include "../Disassembler.hpp"
+#include "../Trace.hpp"
+
+#include <deque>
+#include <cstdio>
+#include <utility>
+#include <string>
+#include <stdexcept>
+
+// Offline viewer of an execution trace (`chip8 --trace`, `chip8-replay -t`):
+// walks back from the machine state saved with the trace, undoing one record
+// at a time, and prints the instructions of the window asked for with
+// their disassembly and what each changed, after the registers before the
+// first one. By default the window is the last `count` instructions;
+// `-c` starts it at an instruction count instead, `-a` keeps the
+// instructions at one address only.
+//
+//     chip8-trace [-n count] [-c cycle] [-a address] dump
+
+struct Options {
+    std::size_t   count   = 32;
+    std::uint64_t cycle   = 0;  // First instruction shown, from the end if 0
+    int           address = -1; // Only instructions at this address, any if -1
+    std::string   dump;
+};
+
+// What the walk restores: the registers, and memory and flags for the writes
+struct Registers {
+    std::array<std::uint8_t, 16> V = { };
+    std::uint16_t I = 0, PC = 0;
+    std::uint8_t  SP = 0, DT = 0, ST = 0;
+};
+
+struct Row {
+    std::size_t   record = 0; // Index in the dump
+    std::uint64_t cycle = 0;  // Instructions executed before it
+    Trace::Kind   kind  = Trace::Kind::STEP;
+    std::uint16_t OP    = 0;
+    std::uint32_t count = 0;  // IDLE
+    Registers     before, after;
+    std::string   writes;     // Memory and flags, "[0300] 00>05 r0 00>01"
+};
+
+static Options ParseArgs(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() {
+            if (i+1 >= argc) throw std::runtime_error("chip8-trace: missing value for " + arg);
+            return std::string(argv[++i]);
+        };
+        if      (arg == "-n") opt.count   = std::stoull(value());
+        else if (arg == "-c") opt.cycle   = std::stoull(value());
+        else if (arg == "-a") opt.address = std::stoi(value(), nullptr, 16);
+        else opt.dump = arg;
+    }
+    if (opt.dump.empty()) throw std::runtime_error("chip8-trace: no trace file");
+    return opt;
+}
+
+static Registers Read(const Machine& m) {
+    return {m.V, m.I, m.PC, m.SP, m.DT, m.ST};
+}
+
+// "v1 05>07 I 0300>0302", what differs between two register sets
+static std::string Changes(const Registers& a, const Registers& b) {
+    std::string text;
+    char item[24];
+    for (int r = 0; r < 16; r++)
+        if (a.V[r] != b.V[r]) text += (std::snprintf(item, sizeof item, "v%x %02x>%02x ", r, a.V[r], b.V[r]), item);
+    if (a.I  != b.I)  text += (std::snprintf(item, sizeof item, "I %04x>%04x ", a.I, b.I), item);
+    if (a.SP != b.SP) text += (std::snprintf(item, sizeof item, "SP %u>%u ", a.SP, b.SP), item);
+    if (a.DT != b.DT) text += (std::snprintf(item, sizeof item, "DT %02x>%02x ", a.DT, b.DT), item);
+    if (a.ST != b.ST) text += (std::snprintf(item, sizeof item, "ST %02x>%02x ", a.ST, b.ST), item);
+    return text;
+}
+
+static void PrintRegisters(const Registers& regs) {
+    std::printf(";");
+    for (int r = 0; r < 16; r++) std::printf(" v%x=%02x", r, regs.V[r]);
+    std::printf("\n; PC=%04x I=%04x SP=%u DT=%02x ST=%02x\n", regs.PC, regs.I, regs.SP, regs.DT, regs.ST);
+}
+
+static void PrintRow(const Row& row) {
+    char text[32];
+    if (row.kind == Trace::Kind::TICK) {
+        std::printf("%12llu              tick                     %s\n",
+                    static_cast<unsigned long long>(row.cycle), Changes(row.before, row.after).c_str());
+        return;
+    }
+    if (row.kind == Trace::Kind::IDLE) {
+        std::printf("%12llu  %04x        idle, %u instructions skipped\n",
+                    static_cast<unsigned long long>(row.cycle), row.before.PC, row.count);
+        return;
+    }
+    Disassembler::Format(Disassembler::Decode(row.before.PC, row.OP), text);
+    std::printf("%12llu  %04x  %04x  %-22s %s%s\n", static_cast<unsigned long long>(row.cycle),
+                row.before.PC, row.OP, text, Changes(row.before, row.after).c_str(), row.writes.c_str());
+}
+
+int main(int argc, char* argv[]) {
+    auto opt  = ParseArgs(argc, argv);
+    auto dump = Trace::Load(opt.dump);
+
+    // The machine at the end, only its state matters
+    Chip8 chip8(RomImage::FromBytes(opt.dump, { }));
+    chip8.LoadState(dump.state);
+    Machine m = chip8.State();
+    const auto end = m.cycles;
+
+    // Back from the end: each record gives the state before it, rows of the
+    // window are kept, the walk stops past it
+    std::deque<Row> rows;
+    auto& records = dump.records;
+    for (auto i = records.size(); i-- > 0; ) {
+        auto& record = records[i];
+        Row row;
+        row.record = i;
+        row.kind   = record.kind;
+        row.after  = Read(m);
+
+        if (record.kind == Trace::Kind::BYTES) break; // Its instruction is gone
+        if (record.kind == Trace::Kind::TICK) {
+            m.DT = record.DT, m.ST = record.ST;
+        } else if (record.kind == Trace::Kind::IDLE) {
+            m.cycles -= record.count;
+            row.count = record.count;
+        } else {
+            std::size_t length;
+            auto X = static_cast<std::uint8_t>(record.OP >> 8 & 0xf);
+            auto target = Trace::Overwrites(Decode(record.OP), X, length);
+            auto chunks = (length + Trace::CHUNK - 1) / Trace::CHUNK;
+            if (i < chunks) break;
+            std::uint8_t old[Trace::CHUNK * 2];
+            for (std::size_t c = 0; c < chunks; c++) {
+                auto& bytes = records[i - chunks + c];
+                if (bytes.kind != Trace::Kind::BYTES) throw std::runtime_error("chip8-trace: Corrupted trace " + opt.dump);
+                std::copy_n(Trace::Data(bytes), Trace::CHUNK, old + c * Trace::CHUNK);
+            }
+            char item[24];
+            for (std::size_t b = 0; b < length; b++) {
+                if (target == Trace::Target::MEMORY) {
+                    auto address = (record.I + b) & 0xfff;
+                    if (m.memory[address] != old[b])
+                        row.writes += (std::snprintf(item, sizeof item, "[%04zx] %02x>%02x ", address, old[b], m.memory[address]), item);
+                    m.memory[address] = old[b];
+                } else if (target == Trace::Target::FLAGS) {
+                    if (m.flags[b] != old[b])
+                        row.writes += (std::snprintf(item, sizeof item, "r%zx %02x>%02x ", b, old[b], m.flags[b]), item);
+                    m.flags[b] = old[b];
+                } else {
+                    m.V[b] = old[b];
+                }
+            }
+            i -= chunks;
+            m.V[X] = record.vx, m.V[0xf] = record.vf;
+            m.PC = record.PC, m.I = record.I, m.SP = record.SP, m.DT = record.DT, m.ST = record.ST;
+            m.cycles--;
+            row.OP = record.OP;
+        }
+        row.before = Read(m);
+        row.cycle  = m.cycles;
+
+        if (opt.cycle && row.cycle < opt.cycle) break;
+        if (opt.address >= 0 && (record.kind != Trace::Kind::STEP || record.PC != opt.address)) continue;
+        if (!opt.cycle && rows.size() == opt.count) break;
+        rows.push_front(std::move(row));
+        if (rows.size() > opt.count) rows.pop_back(); // Later than the first `count` from `cycle`
+    }
+
+    std::uint64_t start = end;
+    for (auto& record: records)
+        start -= record.kind == Trace::Kind::STEP ? 1 : record.kind == Trace::Kind::IDLE ? record.count : 0;
+    std::printf("; %s: %zu records, instructions %llu to %llu, quirks %s\n", opt.dump.c_str(), records.size(),
+                static_cast<unsigned long long>(start), static_cast<unsigned long long>(end),
+                Quirks::Name(dump.quirks).c_str());
+    if (rows.empty()) { std::printf("; nothing in that window\n"); return 0; }
+    PrintRegisters(rows.front().before);
+    std::printf(";      cycle  addr  word  instruction            changes\n");
+    for (auto& row: rows) PrintRow(row);
+
+    // A trap leaves the machine on the instruction that faulted
+    if (!dump.fault.empty() && rows.back().record + 1 == records.size()) {
+        char text[32];
+        auto& state = chip8.State();
+        auto OP = chip8.Fetch();
+        Disassembler::Format(Disassembler::Decode(state.PC, OP), text);
+        std::printf("%12llu  %04x  %04x  %-22s %s\n", static_cast<unsigned long long>(end),
+                    state.PC, OP, text, dump.fault.c_str());
+    }
+    return 0;
+}